@@ -48,6 +48,7 @@
 #include <stdlib.h>
 
 #include "recoil-stdio.h"
+#include "recoil-pixels.h"
 #include "formats.h"
 
 #define GFP_RGB	0
@@ -204,15 +205,7 @@ DLL_EXPORT BOOL API gfpLoadPictureGetLine(void *ptr, INT line, unsigned char *bu
 {
 	const RECOIL *recoil = (const RECOIL *) ptr;
 	int width = RECOIL_GetWidth(recoil);
-	const int *pixels = RECOIL_GetPixels(recoil) + line * width;
-
-	for (int x = 0; x < width; x++) {
-		int rgb = pixels[x];
-		buffer[x * 3] = (unsigned char) (rgb >> 16);
-		buffer[x * 3 + 1] = (unsigned char) (rgb >> 8);
-		buffer[x * 3 + 2] = (unsigned char) rgb;
-	}
-
+	RECOIL_ConvertPixels(buffer, RECOIL_GetPixels(recoil) + line * width, width, RECOIL_PIXEL_FORMAT_RGB24);
 	return TRUE;
 }
 
@@ -21,66 +21,511 @@
  * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#define NULL_DEVICE "NUL"
+#else
+#define NULL_DEVICE "/dev/null"
+#endif
 
 #include "recoil-stdio.h"
+#include "pngsave.h"
+#ifdef RECOIL_MEMORY_STATS
+#include "recoil-memory.h"
+#endif
 
-int main(int argc, char **argv)
+typedef enum {
+	PHASE_DECODE,
+	PHASE_GET_COLORS,
+	PHASE_TO_PALETTE,
+	PHASE_SAVE_PNG,
+	PHASE_COUNT
+} Phase;
+
+static const char * const phase_names[PHASE_COUNT] = { "Decode", "GetColors", "ToPalette", "SavePng" };
+
+typedef enum {
+	OUTPUT_TEXT,
+	OUTPUT_CSV,
+	OUTPUT_JSON
+} OutputFormat;
+
+typedef struct {
+	int64_t min;
+	int64_t median;
+	int64_t p95;
+} PhaseStats;
+
+typedef struct {
+	const char *filename;
+	const char *error;
+	char platform[RECOIL_MAX_PLATFORM_LENGTH + 1];
+	int width;
+	int height;
+	int colors;
+	int content_len;
+	PhaseStats phases[PHASE_COUNT];
+#ifdef RECOIL_MEMORY_STATS
+	RECOILMemoryStats memory;
+#endif
+} FileResult;
+
+typedef struct {
+	char platform[RECOIL_MAX_PLATFORM_LENGTH + 1];
+	int files;
+	int64_t bytes;
+	int64_t pixels;
+	/* Sums of per-file medians. */
+	int64_t ns[PHASE_COUNT];
+#ifdef RECOIL_MEMORY_STATS
+	/* Maximums of per-file peaks. */
+	int64_t heap_peak;
+	int stack_peak;
+#endif
+} PlatformResult;
+
+static int repeat = 10;
+static int warmup = 1;
+static bool save_png = true;
+static OutputFormat output_format = OUTPUT_TEXT;
+static int output_count = 0;
+static PlatformResult *platforms = NULL;
+static int platforms_count = 0;
+
+static void print_help(void)
 {
-	if (argc < 2) {
-		fprintf(stderr, "benchmark: no input files\n");
-		return 1;
+	printf(
+		"Usage: benchmark [OPTIONS] INPUTFILE...\n"
+		"Options:\n"
+		"-n N     --repeat=N      Time N runs of each phase (default 10)\n"
+		"-w N     --warmup=N      Discard N initial runs (default 1)\n"
+		"         --no-png        Skip the SavePng phase\n"
+		"         --csv           Output CSV\n"
+		"         --json          Output JSON\n"
+		"-h       --help          Display this information\n"
+	);
+}
+
+static int64_t get_time_ns(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter;
+	LARGE_INTEGER frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return counter.QuadPart / frequency.QuadPart * 1000000000
+		+ counter.QuadPart % frequency.QuadPart * 1000000000 / frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static int compare_samples(const void *p1, const void *p2)
+{
+	int64_t a = *(const int64_t *) p1;
+	int64_t b = *(const int64_t *) p2;
+	return a < b ? -1 : a > b;
+}
+
+static void compute_stats(PhaseStats *stats, int64_t *samples, int count)
+{
+	qsort(samples, count, sizeof(samples[0]), compare_samples);
+	stats->min = samples[0];
+	stats->median = (count & 1) != 0 ? samples[count >> 1] : (samples[(count >> 1) - 1] + samples[count >> 1]) >> 1;
+	// nearest rank
+	stats->p95 = samples[(count * 95 + 99) / 100 - 1];
+}
+
+static double get_per_second(int64_t amount, int64_t ns)
+{
+	return ns == 0 ? 0 : amount * 1e9 / ns;
+}
+
+static bool run_file(RECOIL *recoil, FileResult *result, const uint8_t *content, int64_t *samples)
+{
+	const char *filename = result->filename;
+	for (int run = -warmup; run < repeat; run++) {
+		int64_t t[PHASE_COUNT + 1];
+		t[PHASE_DECODE] = get_time_ns();
+		if (!RECOIL_Decode(recoil, filename, content, result->content_len)) {
+			result->error = "decoding error";
+			return false;
+		}
+		t[PHASE_GET_COLORS] = get_time_ns();
+		int colors = RECOIL_GetColors(recoil);
+		int64_t colors_end = get_time_ns();
+
+		// ToPalette must not reuse the colors found by GetColors
+		RECOIL_Decode(recoil, filename, content, result->content_len);
+		t[PHASE_TO_PALETTE] = get_time_ns();
+		RECOIL_ToPalette(recoil);
+		t[PHASE_SAVE_PNG] = get_time_ns();
+		if (RECOIL_GetColors(recoil) != colors) {
+			result->error = "GetColors differs after ToPalette";
+			return false;
+		}
+
+		t[PHASE_COUNT] = t[PHASE_SAVE_PNG];
+		if (save_png) {
+			FILE *fp = fopen(NULL_DEVICE, "wb");
+			if (fp == NULL) {
+				result->error = "cannot open " NULL_DEVICE;
+				return false;
+			}
+			t[PHASE_SAVE_PNG] = get_time_ns();
+			bool ok = RECOIL_SavePng(recoil, fp);
+			t[PHASE_COUNT] = get_time_ns();
+			if (!ok) {
+				result->error = "PNG writing error";
+				return false;
+			}
+		}
+
+		if (run >= 0) {
+			samples[PHASE_DECODE * repeat + run] = t[PHASE_GET_COLORS] - t[PHASE_DECODE];
+			samples[PHASE_GET_COLORS * repeat + run] = colors_end - t[PHASE_GET_COLORS];
+			samples[PHASE_TO_PALETTE * repeat + run] = t[PHASE_SAVE_PNG] - t[PHASE_TO_PALETTE];
+			samples[PHASE_SAVE_PNG * repeat + run] = t[PHASE_COUNT] - t[PHASE_SAVE_PNG];
+		}
+		result->colors = colors;
 	}
+	result->width = RECOIL_GetWidth(recoil);
+	result->height = RECOIL_GetHeight(recoil);
+	strcpy(result->platform, RECOIL_GetPlatform(recoil));
+	for (int phase = 0; phase < PHASE_COUNT; phase++)
+		compute_stats(result->phases + phase, samples + phase * repeat, repeat);
+	return true;
+}
+
+#ifdef RECOIL_MEMORY_STATS
+/* Decodes with a new RECOIL object, so that lazily allocated buffers are counted. */
+static void measure_memory(FileResult *result, const uint8_t *content)
+{
+	RECOILMemory_Start();
 	RECOIL *recoil = RECOILStdio_New();
-	for (int i = 1; i < argc; i++) {
-		const char *arg = argv[i];
-		if (strcmp(arg, "--help") == 0) {
-			printf("Usage: benchmark FILE...\n");
-			return 0;
+	if (recoil != NULL) {
+		if (RECOIL_Decode(recoil, result->filename, content, result->content_len)) {
+			RECOIL_GetColors(recoil);
+			RECOIL_ToPalette(recoil);
 		}
+		RECOIL_Delete(recoil);
+	}
+	RECOILMemory_Stop(&result->memory);
+}
+#endif
 
-		FILE *fp = fopen(arg, "rb");
-		if (fp == NULL) {
-			fprintf(stderr, "benchmark: cannot open %s\n", arg);
-			return 1;
+static bool add_platform(const FileResult *result)
+{
+	PlatformResult *p;
+	for (p = platforms; p < platforms + platforms_count && strcmp(p->platform, result->platform) != 0; p++);
+	if (p == platforms + platforms_count) {
+		p = (PlatformResult *) realloc(platforms, (platforms_count + 1) * sizeof(PlatformResult));
+		if (p == NULL)
+			return false;
+		platforms = p;
+		p += platforms_count++;
+		memset(p, 0, sizeof(PlatformResult));
+		strcpy(p->platform, result->platform);
+	}
+	p->files++;
+	p->bytes += result->content_len;
+	p->pixels += result->width * result->height;
+	for (int phase = 0; phase < PHASE_COUNT; phase++)
+		p->ns[phase] += result->phases[phase].median;
+#ifdef RECOIL_MEMORY_STATS
+	if (p->heap_peak < result->memory.heap_peak)
+		p->heap_peak = result->memory.heap_peak;
+	if (p->stack_peak < result->memory.stack_peak)
+		p->stack_peak = result->memory.stack_peak;
+#endif
+	return true;
+}
+
+static void print_csv_string(const char *s)
+{
+	putchar('"');
+	for (; *s != '\0'; s++) {
+		if (*s == '"')
+			putchar('"');
+		putchar(*s);
+	}
+	putchar('"');
+}
+
+static void print_json_string(const char *s)
+{
+	putchar('"');
+	for (; *s != '\0'; s++) {
+		int c = *s & 0xff;
+		if (c == '"' || c == '\\')
+			printf("\\%c", c);
+		else if (c < ' ')
+			printf("\\u%04x", c);
+		else
+			putchar(c);
+	}
+	putchar('"');
+}
+
+static void print_header(void)
+{
+	switch (output_format) {
+	case OUTPUT_TEXT:
+		printf("%d runs after %d warmup, times in microseconds: min median p95\n", repeat, warmup);
+		break;
+	case OUTPUT_CSV:
+		printf("record,file,platform,files,width,height,colors,bytes,pixels");
+		for (int phase = 0; phase < PHASE_COUNT; phase++)
+			printf(",%s_min_ns,%s_median_ns,%s_p95_ns", phase_names[phase], phase_names[phase], phase_names[phase]);
+		printf(",decode_mb_per_s,decode_pixels_per_s");
+#ifdef RECOIL_MEMORY_STATS
+		printf(",heap_allocations,heap_bytes,heap_peak,stack_peak");
+#endif
+		printf(",error\n");
+		break;
+	case OUTPUT_JSON:
+		printf("{\n\t\"repeat\": %d,\n\t\"warmup\": %d,\n\t\"files\": [", repeat, warmup);
+		break;
+	}
+}
+
+static void print_file(const FileResult *result)
+{
+	const PhaseStats *phases = result->phases;
+	int64_t decode_ns = phases[PHASE_DECODE].median;
+	int pixels = result->width * result->height;
+	switch (output_format) {
+	case OUTPUT_TEXT:
+		if (result->error != NULL) {
+			printf("%s: %s\n", result->filename, result->error);
+			break;
+		}
+		printf("%4dx%4d %8d colors", result->width, result->height, result->colors);
+		for (int phase = 0; phase < PHASE_COUNT; phase++) {
+			if (phase == PHASE_SAVE_PNG && !save_png)
+				continue;
+			printf(" %s=%.1f,%.1f,%.1f", phase_names[phase], phases[phase].min * 1e-3, phases[phase].median * 1e-3, phases[phase].p95 * 1e-3);
+		}
+		printf(" %.1f MB/s %.1f Mpixels/s", get_per_second(result->content_len, decode_ns) * 1e-6, get_per_second(pixels, decode_ns) * 1e-6);
+#ifdef RECOIL_MEMORY_STATS
+		printf(" heap=%d,%lld,%lld stack=%d", result->memory.allocations, (long long) result->memory.bytes,
+			(long long) result->memory.heap_peak, result->memory.stack_peak);
+#endif
+		printf(" %s\n", result->filename);
+		break;
+	case OUTPUT_CSV:
+		printf("file,");
+		print_csv_string(result->filename);
+		if (result->error != NULL) {
+			printf(",,,,,,,");
+			for (int phase = 0; phase < PHASE_COUNT; phase++)
+				printf(",,,");
+			printf(",,,");
+#ifdef RECOIL_MEMORY_STATS
+			printf(",,,,");
+#endif
+			print_csv_string(result->error);
+			putchar('\n');
+			break;
+		}
+		putchar(',');
+		print_csv_string(result->platform);
+		printf(",1,%d,%d,%d,%d,%d", result->width, result->height, result->colors, result->content_len, pixels);
+		for (int phase = 0; phase < PHASE_COUNT; phase++)
+			printf(",%lld,%lld,%lld", (long long) phases[phase].min, (long long) phases[phase].median, (long long) phases[phase].p95);
+		printf(",%.3f,%.0f", get_per_second(result->content_len, decode_ns) * 1e-6, get_per_second(pixels, decode_ns));
+#ifdef RECOIL_MEMORY_STATS
+		printf(",%d,%lld,%lld,%d", result->memory.allocations, (long long) result->memory.bytes,
+			(long long) result->memory.heap_peak, result->memory.stack_peak);
+#endif
+		printf(",\n");
+		break;
+	case OUTPUT_JSON:
+		printf(output_count == 0 ? "\n\t\t{ \"file\": " : ",\n\t\t{ \"file\": ");
+		print_json_string(result->filename);
+		if (result->error != NULL) {
+			printf(", \"error\": ");
+			print_json_string(result->error);
+			printf(" }");
+			break;
 		}
-		static uint8_t content[RECOIL_MAX_CONTENT_LENGTH];
-		int content_len = fread(content, 1, sizeof(content), fp);
-		fclose(fp);
+		printf(", \"platform\": ");
+		print_json_string(result->platform);
+		printf(", \"width\": %d, \"height\": %d, \"colors\": %d, \"bytes\": %d, \"pixels\": %d",
+			result->width, result->height, result->colors, result->content_len, pixels);
+		for (int phase = 0; phase < PHASE_COUNT; phase++) {
+			printf(", \"%s\": { \"min_ns\": %lld, \"median_ns\": %lld, \"p95_ns\": %lld }", phase_names[phase],
+				(long long) phases[phase].min, (long long) phases[phase].median, (long long) phases[phase].p95);
+		}
+		printf(", \"decode_mb_per_s\": %.3f, \"decode_pixels_per_s\": %.0f",
+			get_per_second(result->content_len, decode_ns) * 1e-6, get_per_second(pixels, decode_ns));
+#ifdef RECOIL_MEMORY_STATS
+		printf(", \"heap_allocations\": %d, \"heap_bytes\": %lld, \"heap_peak\": %lld, \"stack_peak\": %d",
+			result->memory.allocations, (long long) result->memory.bytes, (long long) result->memory.heap_peak, result->memory.stack_peak);
+#endif
+		printf(" }");
+		break;
+	}
+	output_count++;
+}
 
-		clock_t start_time = clock();
-		if (!RECOIL_Decode(recoil, arg, content, content_len)) {
-			fprintf(stderr, "benchmark: error decoding %s\n", arg);
-			return 1;
+static void print_platforms(void)
+{
+	switch (output_format) {
+	case OUTPUT_TEXT:
+		printf("\nPlatform                files   Decode ms GetColors ms ToPalette ms  SavePng ms     MB/s Mpixels/s");
+#ifdef RECOIL_MEMORY_STATS
+		printf("  Heap KB Stack KB");
+#endif
+		putchar('\n');
+		for (const PlatformResult *p = platforms; p < platforms + platforms_count; p++) {
+			printf("%-22s %6d", p->platform, p->files);
+			for (int phase = 0; phase < PHASE_COUNT; phase++)
+				printf(" %12.3f", p->ns[phase] * 1e-6);
+			printf(" %8.1f %9.1f", get_per_second(p->bytes, p->ns[PHASE_DECODE]) * 1e-6, get_per_second(p->pixels, p->ns[PHASE_DECODE]) * 1e-6);
+#ifdef RECOIL_MEMORY_STATS
+			printf(" %8lld %8d", (long long) (p->heap_peak >> 10), p->stack_peak >> 10);
+#endif
+			putchar('\n');
 		}
-		clock_t decode_time = clock();
-		int colors = RECOIL_GetColors(recoil);
-		clock_t colors_time = clock();
-		RECOIL_ToPalette(recoil);
-		clock_t palette_time = clock();
+		break;
+	case OUTPUT_CSV:
+		for (const PlatformResult *p = platforms; p < platforms + platforms_count; p++) {
+			printf("platform,,");
+			print_csv_string(p->platform);
+			printf(",%d,,,,%lld,%lld", p->files, (long long) p->bytes, (long long) p->pixels);
+			// sums of medians
+			for (int phase = 0; phase < PHASE_COUNT; phase++)
+				printf(",,%lld,", (long long) p->ns[phase]);
+			printf(",%.3f,%.0f", get_per_second(p->bytes, p->ns[PHASE_DECODE]) * 1e-6, get_per_second(p->pixels, p->ns[PHASE_DECODE]));
+#ifdef RECOIL_MEMORY_STATS
+			// maximums of peaks
+			printf(",,,%lld,%d", (long long) p->heap_peak, p->stack_peak);
+#endif
+			printf(",\n");
+		}
+		break;
+	case OUTPUT_JSON:
+		printf("\n\t],\n\t\"platforms\": [");
+		for (const PlatformResult *p = platforms; p < platforms + platforms_count; p++) {
+			printf(p == platforms ? "\n\t\t{ \"platform\": " : ",\n\t\t{ \"platform\": ");
+			print_json_string(p->platform);
+			printf(", \"files\": %d, \"bytes\": %lld, \"pixels\": %lld", p->files, (long long) p->bytes, (long long) p->pixels);
+			for (int phase = 0; phase < PHASE_COUNT; phase++)
+				printf(", \"%s_ns\": %lld", phase_names[phase], (long long) p->ns[phase]);
+			printf(", \"decode_mb_per_s\": %.3f, \"decode_pixels_per_s\": %.0f",
+				get_per_second(p->bytes, p->ns[PHASE_DECODE]) * 1e-6, get_per_second(p->pixels, p->ns[PHASE_DECODE]));
+#ifdef RECOIL_MEMORY_STATS
+			printf(", \"heap_peak\": %lld, \"stack_peak\": %d", (long long) p->heap_peak, p->stack_peak);
+#endif
+			printf(" }");
+		}
+		printf("\n\t]\n}\n");
+		break;
+	}
+}
 
-		RECOIL_Decode(recoil, arg, content, content_len);
-		clock_t decode2_time = clock();
-		RECOIL_ToPalette(recoil);
-		clock_t palette2_time = clock();
-		if (RECOIL_GetColors(recoil) != colors) {
-			fprintf(stderr, "benchmark: RECOIL_GetColors failed for %s\n", arg);
+static bool parse_count(int *result, const char *s, int min)
+{
+	char *end;
+	long n = strtol(s, &end, 10);
+	if (*s == '\0' || *end != '\0' || n < min || n > 1000000) {
+		fprintf(stderr, "benchmark: invalid number: %s\n", s);
+		return false;
+	}
+	*result = (int) n;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+	for (i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		if (arg[0] != '-')
+			break;
+		if (arg[1] == 'n' && arg[2] == '\0' && i + 1 < argc) {
+			if (!parse_count(&repeat, argv[++i], 1))
+				return 1;
+		}
+		else if (strncmp(arg, "--repeat=", 9) == 0) {
+			if (!parse_count(&repeat, arg + 9, 1))
+				return 1;
+		}
+		else if (arg[1] == 'w' && arg[2] == '\0' && i + 1 < argc) {
+			if (!parse_count(&warmup, argv[++i], 0))
+				return 1;
+		}
+		else if (strncmp(arg, "--warmup=", 9) == 0) {
+			if (!parse_count(&warmup, arg + 9, 0))
+				return 1;
+		}
+		else if (strcmp(arg, "--no-png") == 0)
+			save_png = false;
+		else if (strcmp(arg, "--csv") == 0)
+			output_format = OUTPUT_CSV;
+		else if (strcmp(arg, "--json") == 0)
+			output_format = OUTPUT_JSON;
+		else if ((arg[1] == 'h' && arg[2] == '\0')
+			|| strcmp(arg, "--help") == 0) {
+			print_help();
+			return 0;
+		}
+		else {
+			fprintf(stderr, "benchmark: unknown option: %s\n", arg);
 			return 1;
 		}
-		clock_t colors2_time = clock();
-
-		printf("%3dx%3d %4d colors Decode=%2ld,%2ld GetColors=%2ld,%2ld ToPalette=%2ld,%2ld %s\n",
-			RECOIL_GetWidth(recoil), RECOIL_GetHeight(recoil), colors,
-			(  decode_time -    start_time) * 1000L / CLOCKS_PER_SEC, /* RECOIL_Decode time */
-			( decode2_time -  palette_time) * 1000L / CLOCKS_PER_SEC, /* ditto, should be same */
-			(  colors_time -   decode_time) * 1000L / CLOCKS_PER_SEC, /* RECOIL_GetColors time */
-			( colors2_time - palette2_time) * 1000L / CLOCKS_PER_SEC, /* RECOIL_GetColors after RECOIL_Palette, should be smaller */
-			(palette2_time -  decode2_time) * 1000L / CLOCKS_PER_SEC, /* RECOIL_GetPalette time */
-			( palette_time -   colors_time) * 1000L / CLOCKS_PER_SEC, /* RECOIL_GetPalette after RECOIL_GetColors, should be smaller */
-			arg);
 	}
-	return 0;
+	if (i >= argc) {
+		fprintf(stderr, "benchmark: no input files\n");
+		return 1;
+	}
+
+	RECOIL *recoil = RECOILStdio_New();
+	uint8_t *content = (uint8_t *) malloc(RECOIL_MAX_CONTENT_LENGTH);
+	int64_t *samples = (int64_t *) malloc(PHASE_COUNT * repeat * sizeof(int64_t));
+	if (recoil == NULL || content == NULL || samples == NULL) {
+		fprintf(stderr, "benchmark: out of memory\n");
+		return 1;
+	}
+	print_header();
+	bool ok = true;
+	for (; i < argc; i++) {
+		FileResult result;
+		memset(&result, 0, sizeof(result));
+		result.filename = argv[i];
+		FILE *fp = fopen(result.filename, "rb");
+		if (fp == NULL)
+			result.error = "cannot open";
+		else {
+			result.content_len = fread(content, 1, RECOIL_MAX_CONTENT_LENGTH, fp);
+			fclose(fp);
+			if (run_file(recoil, &result, content, samples)) {
+#ifdef RECOIL_MEMORY_STATS
+				measure_memory(&result, content);
+#endif
+				if (!add_platform(&result))
+					result.error = "out of memory";
+			}
+		}
+		if (result.error != NULL) {
+			fprintf(stderr, "benchmark: %s: %s\n", result.filename, result.error);
+			ok = false;
+		}
+		print_file(&result);
+	}
+	print_platforms();
+	free(platforms);
+	free(samples);
+	free(content);
+	RECOIL_Delete(recoil);
+	return ok ? 0 : 1;
 }
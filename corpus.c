@@ -0,0 +1,604 @@
+/*
+ * corpus.c - generate deterministic synthetic pictures in all supported formats
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "recoil-container.h"
+#include "recoil-stdio.h"
+
+/* Must match corpus.pl. */
+#define CORPUS_MAX_LENGTHS 48
+#define CORPUS_MAX_SIGNATURES 16
+
+typedef struct {
+	int offset;
+	int length;
+	const char *s;
+} CorpusSignature;
+
+typedef struct {
+	const char *ext;
+	/* File lengths tested by the decoder, zero-terminated. */
+	int lengths[CORPUS_MAX_LENGTHS];
+	/* Strings the decoder expects at fixed offsets, terminated with offset -1. */
+	CorpusSignature signatures[CORPUS_MAX_SIGNATURES];
+} CorpusRecipe;
+
+#include "corpus.h"
+
+/* Tried after the recipe lengths, for formats with lengths computed from the contents. */
+static const int fallback_lengths[] = { 256, 1024, 4096, 7680, 8000, 8192, 16384, 32000, 32768, 65536, 0 };
+
+static int entropy = 8;
+static int run_length = 1;
+static int size = 0;
+static uint32_t seed = 1;
+static bool verbose = false;
+static const char *missing_file = NULL;
+
+static void print_help(void)
+{
+	printf(
+		"Usage: corpus [OPTIONS] OUTPUTDIR\n"
+		"Options:\n"
+		"         --size=N        Try files of N bytes first\n"
+		"         --entropy=N     Fill with N random bits per byte, 0-8 (default 8)\n"
+		"         --run=N         Repeat each byte N times on average (default 1)\n"
+		"         --seed=N        Set random seed (default 1)\n"
+		"         --missing=FILE  Fail if a format not listed in FILE is not generated,\n"
+		"                         create FILE if it does not exist\n"
+		"-v       --verbose       List generated files\n"
+		"-h       --help          Display this information\n"
+	);
+}
+
+static uint32_t next_random(uint32_t *state)
+{
+	// xorshift32
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+static uint32_t get_seed(const char *ext, int length, int variant)
+{
+	uint32_t state = seed * 0x9e3779b1;
+	for (const char *p = ext; *p != '\0'; p++)
+		state = (state ^ (uint8_t) *p) * 0x01000193;
+	state ^= length * 0x85ebca6b ^ variant * 0xc2b2ae35;
+	return state == 0 ? 1 : state;
+}
+
+/* Fills `content` with runs of random bytes. */
+static void fill(uint8_t *content, int content_len, uint32_t state)
+{
+	int mask = (1 << entropy) - 1;
+	for (int i = 0; i < content_len; ) {
+		uint32_t r = next_random(&state);
+		int n = run_length <= 1 ? 1 : 1 + (int) (r >> 8) % (run_length * 2 - 1);
+		if (n > content_len - i)
+			n = content_len - i;
+		memset(content + i, r & mask, n);
+		i += n;
+	}
+}
+
+static void put_signature(uint8_t *content, int content_len, const CorpusSignature *signature)
+{
+	if (signature->offset + signature->length <= content_len)
+		memcpy(content + signature->offset, signature->s, signature->length);
+}
+
+static void put_be(uint8_t *p, int x, int bytes)
+{
+	while (--bytes >= 0) {
+		p[bytes] = (uint8_t) x;
+		x >>= 8;
+	}
+}
+
+/* Compresses `len` bytes with the ByteRun1 (PackBits) algorithm. Returns the compressed length. */
+static int pack_bits(uint8_t *dest, const uint8_t *src, int len)
+{
+	int d = 0;
+	for (int i = 0; i < len; ) {
+		int run;
+		for (run = 1; i + run < len && run < 128 && src[i + run] == src[i]; run++);
+		if (run >= 3) {
+			dest[d++] = (uint8_t) (257 - run);
+			dest[d++] = src[i];
+			i += run;
+			continue;
+		}
+		int literal;
+		for (literal = 1; i + literal < len && literal < 128; literal++) {
+			if (i + literal + 2 < len && src[i + literal] == src[i + literal + 1] && src[i + literal] == src[i + literal + 2])
+				break;
+		}
+		dest[d++] = (uint8_t) (literal - 1);
+		memcpy(dest + d, src + i, literal);
+		d += literal;
+		i += literal;
+	}
+	return d;
+}
+
+/* Compresses `len` bytes with the Koala Painter RLE: 0xfe, value, count. Returns the compressed length. */
+static int pack_koala(uint8_t *dest, const uint8_t *src, int len)
+{
+	int d = 0;
+	for (int i = 0; i < len; ) {
+		int run;
+		for (run = 1; i + run < len && run < 255 && src[i + run] == src[i]; run++);
+		if (run >= 4 || src[i] == 0xfe) {
+			dest[d++] = 0xfe;
+			dest[d++] = src[i];
+			dest[d++] = (uint8_t) run;
+			i += run;
+		}
+		else
+			dest[d++] = src[i++];
+	}
+	return d;
+}
+
+/* Builds a 320x200 IFF: 16-color ByteRun1-compressed ILBM, 256-color ByteRun1-compressed PBM
+   as written by DeluxePaint for PC in LBM files, or uncompressed 16-color ACBM. Returns the file length. */
+static int build_iff(uint8_t *content, const char *ext, uint32_t state)
+{
+	enum { WIDTH = 320, HEIGHT = 200, ROW_BYTES = WIDTH / 8 };
+	const char *type = strcmp(ext, "ACBM") == 0 ? "ACBM" : strcmp(ext, "LBM") == 0 ? "PBM " : "ILBM";
+	bool chunky = type[0] == 'P';
+	bool compressed = type[0] != 'A';
+	int bitplanes = chunky ? 8 : 4;
+	memcpy(content, "FORMxxxx", 8);
+	memcpy(content + 8, type, 4);
+	memcpy(content + 12, "BMHD", 4);
+	put_be(content + 16, 20, 4);
+	uint8_t *bmhd = content + 20;
+	memset(bmhd, 0, 20);
+	put_be(bmhd, WIDTH, 2);
+	put_be(bmhd + 2, HEIGHT, 2);
+	bmhd[8] = (uint8_t) bitplanes;
+	bmhd[10] = compressed ? 1 : 0; // ByteRun1
+	bmhd[14] = 10;
+	bmhd[15] = 11;
+	put_be(bmhd + 16, WIDTH, 2);
+	put_be(bmhd + 18, HEIGHT, 2);
+	memcpy(content + 40, "CMAP", 4);
+	put_be(content + 44, 3 << bitplanes, 4);
+	fill(content + 48, 3 << bitplanes, state);
+	int body = 48 + (3 << bitplanes);
+	memcpy(content + body, compressed ? "BODY" : "ABIT", 4);
+	// chunky rows for PBM, bitplane rows for ILBM, whole bitplanes for ACBM
+	uint8_t unpacked[WIDTH * HEIGHT];
+	int unpacked_len = ROW_BYTES * bitplanes * HEIGHT;
+	fill(unpacked, unpacked_len, next_random(&state));
+	int len = body + 8;
+	if (compressed) {
+		int row_len = chunky ? WIDTH : ROW_BYTES;
+		for (int i = 0; i < unpacked_len; i += row_len)
+			len += pack_bits(content + len, unpacked + i, row_len);
+	}
+	else {
+		memcpy(content + len, unpacked, unpacked_len);
+		len += unpacked_len;
+	}
+	put_be(content + body + 4, len - body - 8, 4);
+	if ((len & 1) != 0)
+		content[len++] = 0;
+	put_be(content + 4, len - 8, 4);
+	return len;
+}
+
+/* Builds a compressed DEGAS Elite PC1, PC2 or PC3, depending on the last character of `ext`. Returns the file length. */
+static int build_degas(uint8_t *content, const char *ext, uint32_t state)
+{
+	int resolution = ext[2] - '1';
+	content[0] = 0x80;
+	content[1] = (uint8_t) resolution;
+	fill(content + 2, 32, state);
+	// each bitplane of every line compressed separately
+	int row_len = resolution == 0 ? 40 : 80;
+	uint8_t unpacked[32000];
+	fill(unpacked, sizeof(unpacked), next_random(&state));
+	int len = 34;
+	for (int i = 0; i < sizeof(unpacked); i += row_len)
+		len += pack_bits(content + len, unpacked + i, row_len);
+	// color animation: left and right limits, directions, delays
+	memset(content + len, 0, 32);
+	return len + 32;
+}
+
+/* Builds a Koala RLE-compressed C64 multicolor GG or hires JJ with the load address. Returns the file length. */
+static int build_koala(uint8_t *content, const char *ext, uint32_t state)
+{
+	bool koala = strcmp(ext, "GG") == 0;
+	content[0] = 0;
+	content[1] = koala ? 0x60 : 0x5c;
+	uint8_t unpacked[10001];
+	int unpacked_len = koala ? 10001 : 9024;
+	fill(unpacked, unpacked_len, state);
+	return 2 + pack_koala(content + 2, unpacked, unpacked_len);
+}
+
+typedef struct {
+	const char *ext;
+	int (*build)(uint8_t *content, const char *ext, uint32_t state);
+} CorpusBuilder;
+
+/* Compressed formats that random contents rarely decode as, or decode from only a few bytes. */
+static const CorpusBuilder corpus_builders[] = {
+	{ "ACBM", build_iff },
+	{ "GG", build_koala },
+	{ "JJ", build_koala },
+	{ "PC1", build_degas },
+	{ "PC2", build_degas },
+	{ "PC3", build_degas }
+};
+
+typedef struct {
+	const char *name;
+	bool atr;
+	int sector_len;
+	int first_sectors_len;
+	int sectors;
+} Atari8DiskLayout;
+
+/* Every sector layout recognized by open_atari8_disk in recoil-container.c. */
+static const Atari8DiskLayout atari8_disk_layouts[] = {
+	{ "single density ATR", true, 128, 128, 720 },
+	{ "enhanced density ATR", true, 128, 128, 1040 },
+	{ "double density ATR", true, 256, 128, 720 },
+	{ "single density XFD", false, 128, 128, 720 },
+	{ "enhanced density XFD", false, 128, 128, 1040 },
+	{ "double density XFD", false, 256, 128, 720 },
+	{ "double density XFD with 256-byte boot sectors", false, 256, 256, 720 }
+};
+
+#define ATARI8_DISK_MAX_LENGTH (16 + 720 * 256)
+#define ATARI8_DISK_EXT "GR8"
+#define ATARI8_DIRECTORY_SECTOR 361
+
+static uint8_t *get_atari8_sector(uint8_t *disk, const Atari8DiskLayout *layout, int sector)
+{
+	int offset = layout->atr ? 16 : 0;
+	if (sector <= 3)
+		return disk + offset + (sector - 1) * layout->first_sectors_len;
+	return disk + offset + 3 * layout->first_sectors_len + (sector - 4) * layout->sector_len;
+}
+
+/* Builds an Atari DOS 2 disk image with `file` as DISK.`ext`. Returns the image length. */
+static int build_atari8_disk(uint8_t *disk, const Atari8DiskLayout *layout, const char *ext, const uint8_t *file, int file_len)
+{
+	int image_len = 3 * layout->first_sectors_len + (layout->sectors - 3) * layout->sector_len;
+	int disk_len = image_len;
+	if (layout->atr) {
+		memset(disk, 0, 16);
+		disk[0] = 0x96;
+		disk[1] = 0x02;
+		disk[2] = (uint8_t) (image_len >> 4);
+		disk[3] = (uint8_t) (image_len >> 12);
+		disk[4] = (uint8_t) layout->sector_len;
+		disk[5] = (uint8_t) (layout->sector_len >> 8);
+		disk[6] = (uint8_t) (image_len >> 20);
+		disk_len += 16;
+	}
+	memset(disk + disk_len - image_len, 0, image_len);
+
+	// file number 0 in sectors 4, 5, ...
+	int data_len = layout->sector_len - 3;
+	int sectors = (file_len + data_len - 1) / data_len;
+	for (int i = 0; i < sectors; i++) {
+		uint8_t *sector = get_atari8_sector(disk, layout, 4 + i);
+		int count = file_len - i * data_len < data_len ? file_len - i * data_len : data_len;
+		memcpy(sector, file + i * data_len, count);
+		int next = i + 1 < sectors ? 5 + i : 0;
+		sector[data_len] = (uint8_t) (next >> 8);
+		sector[data_len + 1] = (uint8_t) next;
+		sector[data_len + 2] = (uint8_t) count;
+	}
+
+	uint8_t *entry = get_atari8_sector(disk, layout, ATARI8_DIRECTORY_SECTOR);
+	entry[0] = 0x42; // in use, created by DOS 2
+	entry[1] = (uint8_t) sectors;
+	entry[2] = (uint8_t) (sectors >> 8);
+	entry[3] = 4;
+	entry[4] = 0;
+	memcpy(entry + 5, "DISK       ", 11);
+	memcpy(entry + 13, ext, strlen(ext));
+	return disk_len;
+}
+
+/* Stores `file` in every Atari 8-bit disk layout and checks that it is decoded from there.
+   Returns the number of layouts that failed. */
+static int check_atari8_disks(RECOIL *recoil, const char *ext, const uint8_t *file, int file_len)
+{
+	uint8_t *disk = (uint8_t *) malloc(ATARI8_DISK_MAX_LENGTH);
+	uint8_t *buffer = (uint8_t *) malloc(RECOIL_MAX_CONTENT_LENGTH);
+	if (disk == NULL || buffer == NULL) {
+		free(disk);
+		fprintf(stderr, "corpus: out of memory\n");
+		return sizeof(atari8_disk_layouts) / sizeof(atari8_disk_layouts[0]);
+	}
+	int failed = 0;
+	for (const Atari8DiskLayout *layout = atari8_disk_layouts; layout < atari8_disk_layouts + sizeof(atari8_disk_layouts) / sizeof(atari8_disk_layouts[0]); layout++) {
+		int disk_len = build_atari8_disk(disk, layout, ext, file, file_len);
+		RECOILContainer container;
+		if (RECOIL_OpenContainer(&container, layout->atr ? "synthetic.atr" : "synthetic.xfd", disk, disk_len)
+		 && RECOIL_NextContainerEntry(&container)
+		 && container.length == file_len
+		 && RECOIL_DecodeContainerEntry(recoil, &container, buffer)) {
+			if (verbose)
+				printf("%s: %d bytes, %s decoded\n", layout->name, disk_len, container.name);
+		}
+		else {
+			printf("%s: %s not decoded\n", layout->name, ext);
+			failed++;
+		}
+	}
+	free(buffer);
+	free(disk);
+	return failed;
+}
+
+static bool save_file(const char *filename, const uint8_t *content, int content_len)
+{
+	FILE *fp = fopen(filename, "wb");
+	if (fp == NULL)
+		return false;
+	bool ok = fwrite(content, 1, content_len, fp) == content_len;
+	return fclose(fp) == 0 && ok;
+}
+
+/* Tries filling a file of `content_len` bytes in several ways until RECOIL decodes it. */
+static bool try_length(RECOIL *recoil, const CorpusRecipe *recipe, const char *filename, uint8_t *content, int content_len)
+{
+	int signatures_count;
+	for (signatures_count = 0; recipe->signatures[signatures_count].offset >= 0; signatures_count++);
+	// variant 0: all signatures, 1: no signatures, 2..: single signatures, last: zeros with all signatures
+	int variants = 2 + (signatures_count > 1 ? signatures_count : 0) + 1;
+	for (int variant = 0; variant < variants; variant++) {
+		if (variant == 1 && signatures_count == 0)
+			continue;
+		if (variant == variants - 1)
+			memset(content, 0, content_len);
+		else
+			fill(content, content_len, get_seed(recipe->ext, content_len, variant));
+		if (variant == 0 || variant == variants - 1) {
+			for (int i = 0; i < signatures_count; i++)
+				put_signature(content, content_len, recipe->signatures + i);
+		}
+		else if (variant >= 2)
+			put_signature(content, content_len, recipe->signatures + variant - 2);
+		if (RECOIL_Decode(recoil, filename, content, content_len))
+			return true;
+	}
+	return false;
+}
+
+/* Returns the length of the generated file or zero if none decodes. */
+static int generate(RECOIL *recoil, const CorpusRecipe *recipe, const char *filename, uint8_t *content)
+{
+	if (size > 0 && try_length(recoil, recipe, filename, content, size))
+		return size;
+	int (*build)(uint8_t *content, const char *ext, uint32_t state) = NULL;
+	for (const CorpusBuilder *builder = corpus_builders; builder < corpus_builders + sizeof(corpus_builders) / sizeof(corpus_builders[0]); builder++) {
+		if (strcmp(builder->ext, recipe->ext) == 0)
+			build = builder->build;
+	}
+	if (build == NULL && recipe->signatures[0].offset == 0 && memcmp(recipe->signatures[0].s, "FORM", 4) == 0)
+		build = build_iff;
+	if (build != NULL) {
+		int content_len = build(content, recipe->ext, get_seed(recipe->ext, 0, 0));
+		if (RECOIL_Decode(recoil, filename, content, content_len))
+			return content_len;
+	}
+	for (const int *p = recipe->lengths; *p != 0; p++) {
+		if (try_length(recoil, recipe, filename, content, *p))
+			return *p;
+	}
+	for (const int *p = fallback_lengths; *p != 0; p++) {
+		if (try_length(recoil, recipe, filename, content, *p))
+			return *p;
+	}
+	return 0;
+}
+
+/* Compares the formats not generated with the list in `missing_file`,
+   creating it if it does not exist. Returns false if a format not listed is not generated. */
+static bool check_missing(const bool *missing, int recipes_count)
+{
+	FILE *fp = fopen(missing_file, "r");
+	if (fp == NULL) {
+		fp = fopen(missing_file, "w");
+		if (fp == NULL) {
+			fprintf(stderr, "corpus: cannot write %s\n", missing_file);
+			return false;
+		}
+		fprintf(fp, "# Formats not generated by corpus, written by corpus --missing.\n");
+		for (int i = 0; i < recipes_count; i++) {
+			if (missing[i])
+				fprintf(fp, "%s\n", corpus_recipes[i].ext);
+		}
+		if (fclose(fp) != 0) {
+			fprintf(stderr, "corpus: cannot write %s\n", missing_file);
+			return false;
+		}
+		printf("Formats not generated written to %s\n", missing_file);
+		return true;
+	}
+
+	bool *listed = (bool *) calloc(recipes_count, sizeof(bool));
+	if (listed == NULL) {
+		fclose(fp);
+		fprintf(stderr, "corpus: out of memory\n");
+		return false;
+	}
+	char line[64];
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == '#')
+			continue;
+		for (int i = 0; i < recipes_count; i++) {
+			if (strcmp(corpus_recipes[i].ext, line) == 0)
+				listed[i] = true;
+		}
+	}
+	fclose(fp);
+	bool ok = true;
+	for (int i = 0; i < recipes_count; i++) {
+		if (missing[i] && !listed[i]) {
+			printf("%s: not generated and not listed in %s\n", corpus_recipes[i].ext, missing_file);
+			ok = false;
+		}
+		else if (!missing[i] && listed[i])
+			printf("%s: generated, remove it from %s\n", corpus_recipes[i].ext, missing_file);
+	}
+	free(listed);
+	return ok;
+}
+
+static bool parse_int(int *result, const char *s, int min, int max)
+{
+	char *end;
+	long n = strtol(s, &end, 10);
+	if (*s == '\0' || *end != '\0' || n < min || n > max) {
+		fprintf(stderr, "corpus: invalid number: %s\n", s);
+		return false;
+	}
+	*result = (int) n;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	const char *output_dir = NULL;
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		int n;
+		if (arg[0] != '-')
+			output_dir = arg;
+		else if (strncmp(arg, "--size=", 7) == 0) {
+			if (!parse_int(&size, arg + 7, 1, RECOIL_MAX_CONTENT_LENGTH))
+				return 1;
+		}
+		else if (strncmp(arg, "--entropy=", 10) == 0) {
+			if (!parse_int(&entropy, arg + 10, 0, 8))
+				return 1;
+		}
+		else if (strncmp(arg, "--run=", 6) == 0) {
+			if (!parse_int(&run_length, arg + 6, 1, 65536))
+				return 1;
+		}
+		else if (strncmp(arg, "--seed=", 7) == 0) {
+			if (!parse_int(&n, arg + 7, 0, 0x7fffffff))
+				return 1;
+			seed = n;
+		}
+		else if (strncmp(arg, "--missing=", 10) == 0)
+			missing_file = arg + 10;
+		else if ((arg[1] == 'v' && arg[2] == '\0')
+			|| strcmp(arg, "--verbose") == 0)
+			verbose = true;
+		else if ((arg[1] == 'h' && arg[2] == '\0')
+			|| strcmp(arg, "--help") == 0) {
+			print_help();
+			return 0;
+		}
+		else {
+			fprintf(stderr, "corpus: unknown option: %s\n", arg);
+			return 1;
+		}
+	}
+	if (output_dir == NULL) {
+		print_help();
+		return 1;
+	}
+
+	RECOIL *recoil = RECOILStdio_New();
+	uint8_t *content = (uint8_t *) malloc(RECOIL_MAX_CONTENT_LENGTH);
+	if (recoil == NULL || content == NULL) {
+		fprintf(stderr, "corpus: out of memory\n");
+		return 1;
+	}
+	int recipes_count = sizeof(corpus_recipes) / sizeof(corpus_recipes[0]);
+	bool *missing = (bool *) calloc(recipes_count, sizeof(bool));
+	if (missing == NULL) {
+		fprintf(stderr, "corpus: out of memory\n");
+		return 1;
+	}
+	int generated = 0;
+	bool ok = true;
+	for (int i = 0; i < recipes_count; i++) {
+		const CorpusRecipe *recipe = corpus_recipes + i;
+		// companion files of multi-file formats are looked up next to this name
+		char filename[FILENAME_MAX];
+		snprintf(filename, sizeof(filename), "%s/synthetic.%s", output_dir, recipe->ext);
+		int content_len = generate(recoil, recipe, filename, content);
+		if (content_len == 0) {
+			missing[i] = true;
+			continue;
+		}
+		if (!save_file(filename, content, content_len)) {
+			fprintf(stderr, "corpus: cannot write %s\n", filename);
+			ok = false;
+			break;
+		}
+		if (verbose)
+			printf("%s: %d bytes, %dx%d\n", filename, content_len, RECOIL_GetWidth(recoil), RECOIL_GetHeight(recoil));
+		generated++;
+	}
+	printf("%d of %d formats generated\n", generated, recipes_count);
+	if (ok && generated < recipes_count) {
+		printf("Not generated:");
+		for (int i = 0; i < recipes_count; i++) {
+			if (missing[i])
+				printf(" %s", corpus_recipes[i].ext);
+		}
+		printf("\n");
+	}
+	if (ok && missing_file != NULL && !check_missing(missing, recipes_count))
+		ok = false;
+
+	// a raw Atari 8-bit picture that fits on every disk layout
+	for (const CorpusRecipe *recipe = corpus_recipes; ok && recipe < corpus_recipes + recipes_count; recipe++) {
+		if (strcmp(recipe->ext, ATARI8_DISK_EXT) == 0) {
+			char filename[FILENAME_MAX];
+			snprintf(filename, sizeof(filename), "%s/synthetic.%s", output_dir, recipe->ext);
+			int content_len = generate(recoil, recipe, filename, content);
+			if (content_len == 0 || check_atari8_disks(recoil, recipe->ext, content, content_len) > 0)
+				ok = false;
+		}
+	}
+	free(missing);
+	free(content);
+	RECOIL_Delete(recoil);
+	return ok ? 0 : 1;
+}
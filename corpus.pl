@@ -0,0 +1,162 @@
+#!/usr/bin/perl
+# corpus.pl - extract synthetic file recipes from recoil.ci
+#
+# Copyright (C) 2021  Piotr Fusik
+#
+# This file is part of RECOIL (Retro Computer Image Library),
+# see http://recoil.sourceforge.net
+#
+# RECOIL is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published
+# by the Free Software Foundation; either version 2 of the License,
+# or (at your option) any later version.
+#
+# RECOIL is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty
+# of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+# See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+# Usage: perl corpus.pl formats.xml recoil.ci >corpus.h
+#
+# For every extension in formats.xml, follows the `Decode` dispatch in recoil.ci
+# into the decoder methods and collects the file lengths they test
+# and the signatures they expect at fixed offsets.
+# corpus.c fills files according to these recipes and keeps those that RECOIL decodes.
+
+use strict;
+use warnings;
+
+# must match corpus.c
+my $MAX_LENGTHS = 48;
+my $MAX_SIGNATURES = 16;
+my $MAX_CONTENT_LENGTH = 6 << 20;
+my $DEPTH = 3;
+
+my ($formats_xml, $recoil_ci) = @ARGV;
+die "Usage: perl corpus.pl formats.xml recoil.ci\n" unless defined $recoil_ci;
+
+open my $fh, '<', $formats_xml or die "$formats_xml: $!\n";
+my %exts;
+while (<$fh>) {
+	while (m{<ext>([^<]+)</ext>}g) {
+		my $ext = $1;
+		$ext =~ s/&amp;/&/g;
+		$exts{$ext} = 1;
+	}
+}
+close $fh;
+
+open $fh, '<', $recoil_ci or die "$recoil_ci: $!\n";
+my @lines = <$fh>;
+close $fh;
+
+# method name => body
+my %methods;
+for (my $i = 0; $i < @lines; $i++) {
+	next unless $lines[$i] =~ /^\t(?:public |internal |protected )?(?:static )?[\w\[\]#!]+ (\w+)!?\(/;
+	my $name = $1;
+	my $body = '';
+	# expression-bodied methods end at a blank line
+	my $braced = 0;
+	for (my $j = $i; $j < @lines && $lines[$j] =~ /\S/; $j++) {
+		$braced = 1, last if $lines[$j] =~ /^\t\{$/;
+	}
+	for (; $i < @lines && ($braced ? $lines[$i] !~ /^\t}/ : $lines[$i] =~ /\S/); $i++) {
+		$body .= $lines[$i];
+	}
+	$methods{$name} .= $body;
+}
+
+# extension => statement of the `Decode` switch
+my %cases;
+my ($decode) = grep { /switch \(GetPackedExt/ } split /(?=^\t(?:public |internal )?bool Decode\w*!\()/m, ($methods{'DecodeByExt'} // '') . ($methods{'Decode'} // '');
+die "$recoil_ci: Decode not found\n" unless defined $decode;
+my @pending;
+my $statement;
+for my $line (split /\n/, $decode) {
+	if ($line =~ /^\t\tcase PackExt\("([^"]+)"\):/) {
+		if (defined $statement) {
+			@pending = ();
+			undef $statement;
+		}
+		push @pending, $1;
+	}
+	elsif ($line =~ /^\t\tdefault:/) {
+		last;
+	}
+	elsif (@pending) {
+		$statement .= "$line\n";
+		$cases{$_} .= "$line\n" for @pending;
+	}
+}
+
+sub constant($) {
+	my ($expr) = @_;
+	$expr =~ s/\s+//g;
+	# drop parentheses closing the enclosing condition
+	$expr =~ s/\)$// while ($expr =~ tr/)//) > ($expr =~ tr/(//);
+	$expr =~ s/[+\-*<]+$//;
+	return undef unless $expr =~ /^(?:0x[\dA-Fa-f]+|\d+|[+\-*()]|<<)+$/;
+	my $value = eval $expr;
+	return defined $value && $value =~ /^\d+$/ ? $value : undef;
+}
+
+sub c_string($) {
+	my ($s) = @_;
+	$s =~ s/([\\"])/\\$1/g;
+	$s =~ s/([^ -~])/sprintf '\\%03o', ord $1/ge;
+	return "\"$s\"";
+}
+
+sub collect {
+	my ($text, $lengths, $signatures, $seen, $depth) = @_;
+	for (split /\n/, $text) {
+		while (/contentLength\s*(?:==|!=|<=|>=|<|>)\s*([\dA-Fa-fx][\dA-Fa-fx +\-*()<]*)/g) {
+			my $n = constant($1);
+			$lengths->{$_} = 1 for grep { $_ > 0 && $_ <= $MAX_CONTENT_LENGTH } defined $n ? ($n - 1, $n, $n + 1) : ();
+		}
+		if (/^\t+case ([\dx]+(?: [+\-*] [\dx]+)*):/) {
+			my $n = constant($1);
+			$lengths->{$n} = 1 if defined $n && $n > 0 && $n <= $MAX_CONTENT_LENGTH;
+		}
+		while (/IsStringAt\((?:content|Content), ([\dx]+(?: [+\-] [\dx]+)*), "((?:[^"\\]|\\.)*)"\)/g) {
+			my $offset = constant($1);
+			my $s = $2;
+			my %escapes = (n => "\n", r => "\r", t => "\t", 0 => "\0");
+			$s =~ s/\\(.)/$escapes{$1} \/\/ $1/ge;
+			push @$signatures, [ $offset, $s ] if defined $offset;
+		}
+		while (/content\[([\dx]+)\] == ('(?:[^'\\]|\\.)'|0x[\dA-Fa-f]+|\d+)\b/g) {
+			my $offset = constant($1);
+			my $value = $2;
+			$value = $value =~ /^'\\?(.)'$/ ? ord $1 : $value =~ /^0x/ ? hex $value : $value;
+			push @$signatures, [ $offset, chr $value ] if defined $offset && $value < 256;
+		}
+	}
+	return if $depth == 0;
+	while ($text =~ /\b(Decode\w+|Unpack\w+)\s*\(/g) {
+		my $name = $1;
+		next if $seen->{$name}++ || !exists $methods{$name};
+		collect($methods{$name}, $lengths, $signatures, $seen, $depth - 1);
+	}
+}
+
+print "/* Generated automatically from formats.xml and recoil.ci by corpus.pl. Do not edit. */\n\n";
+print "static const CorpusRecipe corpus_recipes[] = {\n";
+for my $ext (sort keys %exts) {
+	my (%lengths, @signatures);
+	my $statement = $cases{uc $ext};
+	collect($statement, \%lengths, \@signatures, {}, $DEPTH) if defined $statement;
+	my @lengths = sort { $a <=> $b } keys %lengths;
+	splice @lengths, $MAX_LENGTHS - 1 if @lengths >= $MAX_LENGTHS;
+	my %unique;
+	@signatures = grep { !$unique{"$_->[0]:$_->[1]"}++ } @signatures;
+	splice @signatures, $MAX_SIGNATURES - 1 if @signatures >= $MAX_SIGNATURES;
+	print "\t{ ", c_string($ext), ", { ", join(', ', @lengths, 0), " },\n\t\t{ ";
+	print map({ "{ $_->[0], " . length($_->[1]) . ', ' . c_string($_->[1]) . ' }, ' } @signatures), "{ -1, 0, NULL } } },\n";
+}
+print "};\n";
@@ -22,6 +22,7 @@
  */
 
 #include "recoil.h"
+#include "recoil-pixels.h"
 #include "formats.h"
 
 #ifdef MAGICK7
@@ -35,8 +36,11 @@
 #include "MagickCore/list.h"
 #include "MagickCore/magick.h"
 #include "MagickCore/pixel-accessor.h"
+#include "MagickCore/colormap.h"
 #include "MagickCore/quantum-private.h"
+#include "MagickCore/option.h"
 #include "MagickCore/string_.h"
+#include "MagickCore/thread_.h"
 #include "MagickCore/module.h"
 #define MAGICK7_COMMA_EXCEPTION(exception) , exception
 #else
@@ -49,18 +53,206 @@
 #include "magick/image.h"
 #include "magick/list.h"
 #include "magick/magick.h"
+#include "magick/colormap.h"
 #include "magick/quantum-private.h"
+#include "magick/option.h"
 #include "magick/string_.h"
+#include "magick/thread_.h"
 #include "magick/module.h"
 #define MAGICK7_COMMA_EXCEPTION(exception)
 #endif
 
-static MagickBooleanType IsRECOIL(const unsigned char *magick, const size_t length)
+static const struct Signature {
+	const char *magic;
+	size_t offset;
+	const char *ext;
+} signatures[] = {
+	// IFF: any of the FORM types decoded by RECOIL, but not other IFF files
+	{ "FORM????ILBM", 0, "ILBM" },
+	{ "FORM????PBM ", 0, "ILBM" },
+	{ "FORM????ACBM", 0, "ILBM" },
+	{ "FORM????DEEP", 0, "ILBM" },
+	{ "FORM????TVPP", 0, "ILBM" },
+	{ "FORM????RGB8", 0, "ILBM" },
+	{ "FORM????RGBN", 0, "ILBM" },
+	{ "FORM????ANIM", 0, "ILBM" },
+	{ "FORM????DPST", 0, "ILBM" },
+	{ "MSXMIG", 0, "MIG" },
+	{ "MAKI01A ", 0, "MAG" },
+	{ "MAKI01B ", 0, "MAG" },
+	{ "MAKI02  ", 0, "MAG" },
+	{ "G2FZLIB", 0, "G2F" },
+	{ "TRUECOLR", 0, "TCP" },
+	{ "HCMA8", 0, "HCM" },
+	{ "IMDC", 0, "IC1" },
+	{ "RAG-D!", 0, "RAG" },
+	{ "FLUFF64", 0, "FLF" },
+	{ "IS_IMAGE", 0, "IIM" },
+	{ "CALAMUSCRG", 0, "CRG" },
+	{ "tre1", 0, "TRE" },
+	{ "LinS", 0, "MSP" },
+	{ "DanM", 0, "MSP" },
+	{ "INT95a", 0, "INT" },
+	{ "COKE format.", 0, "TG1" },
+	{ "tm89", 0, "PSC" },
+	{ "EYES", 0, "CE1" },
+	{ "PIXT", 0, "PIX" },
+	{ "XLPC", 0, "XLP" },
+	{ "XLPB", 0, "XLP" },
+	{ "XLPM", 0, "XLP" },
+	{ "AWBM", 0, "EPA" },
+	{ "Indy", 0, "TRU" },
+	{ "TRUP", 0, "TRP" },
+	{ "GF25", 0, "GFB" }
+};
+
+// '?' in `magic` matches any byte
+static MagickBooleanType MatchMagic(const unsigned char *p, const char *magic, size_t magic_length)
 {
-	// TODO: Should we really perform checks, having only seven bytes of file?
+	for (size_t i = 0; i < magic_length; i++) {
+		if (magic[i] != '?' && p[i] != (unsigned char) magic[i])
+			return MagickFalse;
+	}
 	return MagickTrue;
 }
 
+static const char *FindSignature(const unsigned char *magick, size_t length)
+{
+	for (const struct Signature *ps = signatures; ps < signatures + sizeof(signatures) / sizeof(signatures[0]); ps++) {
+		size_t magic_length = strlen(ps->magic);
+		if (ps->offset + magic_length <= length && MatchMagic(magick + ps->offset, ps->magic, magic_length))
+			return ps->ext;
+	}
+	return NULL;
+}
+
+static MagickBooleanType IsRECOIL(const unsigned char *magick, const size_t length)
+{
+	// Most retro formats have no signature and are only recognized by the filename extension.
+	return FindSignature(magick, length) != NULL ? MagickTrue : MagickFalse;
+}
+
+// Decoder and buffers reused by all images read on a thread.
+typedef struct {
+	RECOIL *recoil;
+	uint8_t *content;
+	size_t content_capacity;
+	unsigned char *rgb;
+	size_t rgb_capacity;
+} RECOILThreadState;
+
+static MagickThreadKey thread_state_key;
+static MagickBooleanType thread_state_key_created = MagickFalse;
+
+static void DestroyThreadState(void *value)
+{
+	RECOILThreadState *state = (RECOILThreadState *) value;
+	if (state == NULL)
+		return;
+	if (state->recoil != NULL)
+		RECOIL_Delete(state->recoil);
+	free(state->content);
+	free(state->rgb);
+	free(state);
+}
+
+static RECOILThreadState *GetThreadState(void)
+{
+	if (!thread_state_key_created)
+		return NULL;
+	RECOILThreadState *state = (RECOILThreadState *) GetMagickThreadValue(thread_state_key);
+	if (state == NULL) {
+		state = (RECOILThreadState *) calloc(1, sizeof(RECOILThreadState));
+		if (state == NULL)
+			return NULL;
+		state->recoil = RECOIL_New();
+		if (state->recoil == NULL || !SetMagickThreadValue(thread_state_key, state)) {
+			DestroyThreadState(state);
+			return NULL;
+		}
+	}
+	return state;
+}
+
+static void *GrowBuffer(void *buffer, size_t *capacity, size_t length)
+{
+	if (length <= *capacity)
+		return buffer;
+	void *new_buffer = realloc(buffer, length);
+	if (new_buffer != NULL)
+		*capacity = length;
+	return new_buffer;
+}
+
+static MagickBooleanType DecodeRECOIL(RECOIL *recoil, const ImageInfo *image_info, const uint8_t *content, int content_len)
+{
+	if (RECOIL_Decode(recoil, image_info->filename, content, content_len))
+		return MagickTrue;
+	// no or misleading filename extension: try the format requested with "FMT:file", then the signature
+	char filename[MagickPathExtent];
+	if (image_info->magick[0] != '\0' && LocaleCompare(image_info->magick, "RECOIL") != 0) {
+		(void) FormatLocaleString(filename, sizeof(filename), "x.%s", image_info->magick);
+		if (RECOIL_Decode(recoil, filename, content, content_len))
+			return MagickTrue;
+	}
+	const char *ext = FindSignature(content, content_len);
+	if (ext != NULL) {
+		(void) FormatLocaleString(filename, sizeof(filename), "x.%s", ext);
+		if (RECOIL_Decode(recoil, filename, content, content_len))
+			return MagickTrue;
+	}
+	return MagickFalse;
+}
+
+static MagickBooleanType SetRECOILPalettePixels(Image *image, RECOIL *recoil, const int *palette, ExceptionInfo *exception)
+{
+	int colors = RECOIL_GetColors(recoil);
+	if (!AcquireImageColormap(image, colors MAGICK7_COMMA_EXCEPTION(exception)))
+		return MagickFalse;
+	for (int i = 0; i < colors; i++) {
+		image->colormap[i].red = ScaleCharToQuantum((unsigned char) (palette[i] >> 16));
+		image->colormap[i].green = ScaleCharToQuantum((unsigned char) (palette[i] >> 8));
+		image->colormap[i].blue = ScaleCharToQuantum((unsigned char) palette[i]);
+	}
+	int width = RECOIL_GetWidth(recoil);
+	int height = RECOIL_GetHeight(recoil);
+	const uint8_t *indexes = RECOIL_GetIndexes(recoil);
+	for (int y = 0; y < height; y++) {
+#ifdef MAGICK7
+		Quantum *q = QueueAuthenticPixels(image, 0, y, width, 1, exception);
+		if (q == NULL)
+			return MagickFalse;
+		for (int x = 0; x < width; x++) {
+			SetPixelIndex(image, indexes[y * width + x], q);
+			q += GetPixelChannels(image);
+		}
+#else
+		if (QueueAuthenticPixels(image, 0, y, width, 1, exception) == NULL)
+			return MagickFalse;
+		IndexPacket *q = GetAuthenticIndexQueue(image);
+		for (int x = 0; x < width; x++)
+			q[x] = (IndexPacket) indexes[y * width + x];
+#endif
+		if (!SyncAuthenticPixels(image, exception))
+			return MagickFalse;
+	}
+	return SyncImage(image MAGICK7_COMMA_EXCEPTION(exception));
+}
+
+static MagickBooleanType SetRECOILFramePixels(Image *image, RECOILThreadState *state, int frame, ExceptionInfo *exception)
+{
+	int width = RECOIL_GetWidth(state->recoil);
+	int height = RECOIL_GetHeight(state->recoil);
+	unsigned char *rgb = GrowBuffer(state->rgb, &state->rgb_capacity, (size_t) width * height * 3);
+	if (rgb == NULL) {
+		(void) ThrowMagickException(exception, GetMagickModule(), ResourceLimitError, "MemoryAllocationFailed", "`%s'", image->filename);
+		return MagickFalse;
+	}
+	state->rgb = rgb;
+	RECOIL_ConvertPixels(rgb, RECOIL_GetPixels(state->recoil) + frame * width * height, width * height, RECOIL_PIXEL_FORMAT_RGB24);
+	return ImportImagePixels(image, 0, 0, width, height, "RGB", CharPixel, rgb MAGICK7_COMMA_EXCEPTION(exception));
+}
+
 static Image *ReadRECOILImage(const ImageInfo *image_info, ExceptionInfo *exception)
 {
 	assert(image_info != NULL);
@@ -75,86 +267,98 @@ static Image *ReadRECOILImage(const ImageInfo *image_info, ExceptionInfo *except
 		return NULL;
 	}
 
-	MagickSizeType content_len = GetBlobSize(image);
-	if (content_len > RECOIL_MAX_CONTENT_LENGTH)
-		ThrowReaderException(CorruptImageError, "ImageTypeNotSupported");
-	if (content_len == 0) // failed to get file length
-		content_len = RECOIL_MAX_CONTENT_LENGTH;
-	RECOIL *recoil = RECOIL_New();
-	if (recoil == NULL)
+	RECOILThreadState *state = GetThreadState();
+	if (state == NULL)
 		ThrowReaderException(ResourceLimitError, "MemoryAllocationFailed");
-	uint8_t *content = malloc(content_len);
-	if (content == NULL) {
-		RECOIL_Delete(recoil);
-		ThrowReaderException(ResourceLimitError, "MemoryAllocationFailed");
-	}
-	content_len = ReadBlob(image, content_len, content);
-	if (content_len < 0) {
-		free(content);
-		RECOIL_Delete(recoil);
-		ThrowReaderException(CorruptImageError, "UnableToReadImageData");
-	}
-	if (!RECOIL_Decode(recoil, image_info->filename, content, content_len)) {
-		free(content);
-		RECOIL_Delete(recoil);
+	RECOIL *recoil = state->recoil;
+	MagickSizeType blob_size = GetBlobSize(image);
+	if (blob_size > RECOIL_MAX_CONTENT_LENGTH)
 		ThrowReaderException(CorruptImageError, "ImageTypeNotSupported");
+	// decode in-memory blobs without copying
+	const uint8_t *content = GetBlobStreamData(image);
+	ssize_t content_len = (ssize_t) blob_size;
+	if (content == NULL || content_len == 0) {
+		if (content_len == 0) // failed to get file length
+			content_len = RECOIL_MAX_CONTENT_LENGTH;
+		uint8_t *buffer = GrowBuffer(state->content, &state->content_capacity, content_len);
+		if (buffer == NULL)
+			ThrowReaderException(ResourceLimitError, "MemoryAllocationFailed");
+		state->content = buffer;
+		content_len = ReadBlob(image, content_len, buffer);
+		if (content_len < 0)
+			ThrowReaderException(CorruptImageError, "UnableToReadImageData");
+		content = buffer;
 	}
-	free(content);
-
-	image->depth = 8;
-	if (!SetImageExtent(image, RECOIL_GetWidth(recoil), RECOIL_GetHeight(recoil) MAGICK7_COMMA_EXCEPTION(exception))) {
-#ifndef MAGICK7
-		InheritException(exception, &image->exception);
-#endif
-		RECOIL_Delete(recoil);
-		(void) DestroyImageList(image);
-		return NULL;
-	}
+	const char *frames_option = GetImageOption(image_info, "recoil:frames");
+	RECOIL_SetBlendFrames(recoil, frames_option == NULL || !IsStringTrue(frames_option));
+	if (!DecodeRECOIL(recoil, image_info, content, (int) content_len))
+		ThrowReaderException(CorruptImageError, "ImageTypeNotSupported");
 
+	int images = 0;
+	// IFF ANIM frames are decoded one after another, each becomes an image
+	do {
+		int width = RECOIL_GetWidth(recoil);
+		int height = RECOIL_GetHeight(recoil);
+		int stored_frames = RECOIL_GetStoredFrames(recoil);
+		int duration = RECOIL_GetAnimationFrameDuration(recoil);
+		float x_dpi = RECOIL_GetXPixelsPerInch(recoil);
+		for (int frame = 0; frame < stored_frames; frame++, images++) {
+			if (images > 0) {
+				AcquireNextImage(image_info, image MAGICK7_COMMA_EXCEPTION(exception));
+				if (GetNextImageInList(image) == NULL) {
+					(void) DestroyImageList(image);
+					return NULL;
+				}
+				image = SyncNextImageInList(image);
+			}
+			image->depth = 8;
+			if (stored_frames > 1) {
+				// flickering pictures alternate frames every 1/50 second
+				image->delay = 2;
+				image->ticks_per_second = 100;
+				image->iterations = 0;
+			}
+			else if (duration > 0) {
+				image->delay = (duration + 5) / 10;
+				image->ticks_per_second = 100;
+				image->iterations = 0;
+			}
+			if (x_dpi != 0) {
+				image->units = PixelsPerInchResolution;
 #ifdef MAGICK7
-	Quantum
+				image->resolution.x = x_dpi;
+				image->resolution.y = RECOIL_GetYPixelsPerInch(recoil);
 #else
-	PixelPacket
+				image->x_resolution = x_dpi;
+				image->y_resolution = RECOIL_GetYPixelsPerInch(recoil);
 #endif
-		*q = QueueAuthenticPixels(image, 0, 0, image->columns, image->rows, exception);
-	if (q == NULL) {
-		RECOIL_Delete(recoil);
-		(void) DestroyImageList(image);
-		return NULL;
-	}
-
-	float x_dpi = RECOIL_GetXPixelsPerInch(recoil);
-	if (x_dpi != 0) {
-		image->units = PixelsPerInchResolution;
-#ifdef MAGICK7
-		image->resolution.x = x_dpi;
-		image->resolution.y = RECOIL_GetYPixelsPerInch(recoil);
-#else
-		image->x_resolution = x_dpi;
-		image->x_resolution = RECOIL_GetYPixelsPerInch(recoil);
+			}
+			if (image_info->ping) {
+				image->columns = width;
+				image->rows = height;
+				continue;
+			}
+			if (!SetImageExtent(image, width, height MAGICK7_COMMA_EXCEPTION(exception))) {
+#ifndef MAGICK7
+				InheritException(exception, &image->exception);
 #endif
-	}
-
-	const int *pixels = RECOIL_GetPixels(recoil);
-	int num_pixels = image->columns * image->rows;
-	for (int i = 0; i < num_pixels; i++) {
-		int rgb = pixels[i];
-		Quantum r = ScaleCharToQuantum((unsigned char) (rgb >> 16));
-		Quantum g = ScaleCharToQuantum((unsigned char) (rgb >> 8));
-		Quantum b = ScaleCharToQuantum((unsigned char) rgb);
-#ifdef MAGICK7
-		SetPixelRed(image, r, q);
-		SetPixelGreen(image, g, q);
-		SetPixelBlue(image, b, q);
-		q += GetPixelChannels(image);
-#else
-		q[i].red = r;
-		q[i].green = g;
-		q[i].blue = b;
+				(void) DestroyImageList(image);
+				return NULL;
+			}
+			// GetColors and ToPalette only see the first frame
+			const int *palette = stored_frames == 1 ? RECOIL_ToPalette(recoil) : NULL;
+			MagickBooleanType ok = palette != NULL
+				? SetRECOILPalettePixels(image, recoil, palette, exception)
+				: SetRECOILFramePixels(image, state, frame, exception);
+			if (!ok) {
+#ifndef MAGICK7
+				InheritException(exception, &image->exception);
 #endif
-	}
-	RECOIL_Delete(recoil);
-	SyncAuthenticPixels(image, exception);
+				(void) DestroyImageList(image);
+				return NULL;
+			}
+		}
+	} while (RECOIL_DecodeNextAnimationFrame(recoil));
 
 	CloseBlob(image);
 	return GetFirstImageInList(image);
@@ -167,6 +371,8 @@ static const struct Format {
 
 ModuleExport unsigned long RegisterRECOILImage(void)
 {
+	if (!thread_state_key_created)
+		thread_state_key_created = CreateMagickThreadKey(&thread_state_key, DestroyThreadState);
 	for (const struct Format *pf = formats; pf < formats + sizeof(formats) / sizeof(formats[0]); pf++) {
 #ifdef MAGICK7
 		MagickInfo *entry = AcquireMagickInfo("RECOIL", pf->name, pf->description);
@@ -186,4 +392,9 @@ ModuleExport void UnregisterRECOILImage(void)
 {
 	for (const struct Format *pf = formats; pf < formats + sizeof(formats) / sizeof(formats[0]); pf++)
 		UnregisterMagickInfo(pf->name);
+	if (thread_state_key_created) {
+		DestroyThreadState(GetMagickThreadValue(thread_state_key));
+		(void) DeleteMagickThreadKey(thread_state_key);
+		thread_state_key_created = MagickFalse;
+	}
 }
@@ -0,0 +1,254 @@
+/*
+ * imgsave.c - save PNM, PAM, BMP, raw RGBA and QOI files
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "imgsave.h"
+#include "recoil-pixels.h"
+
+static bool close_file(FILE *fp, bool ok)
+{
+	return fclose(fp) == 0 && ok;
+}
+
+static void put16le(uint8_t *p, int x)
+{
+	p[0] = (uint8_t) x;
+	p[1] = (uint8_t) (x >> 8);
+}
+
+static void put32le(uint8_t *p, int x)
+{
+	put16le(p, x);
+	put16le(p + 2, x >> 16);
+}
+
+static void put32be(uint8_t *p, int x)
+{
+	p[0] = (uint8_t) (x >> 24);
+	p[1] = (uint8_t) (x >> 16);
+	p[2] = (uint8_t) (x >> 8);
+	p[3] = (uint8_t) x;
+}
+
+static bool save_rows(const RECOIL *recoil, FILE *fp, RECOILPixelFormat format)
+{
+	int width = RECOIL_GetWidth(recoil);
+	int height = RECOIL_GetHeight(recoil);
+	int row_length = width * RECOIL_GetPixelFormatSize(format);
+	uint8_t *row = (uint8_t *) malloc(row_length);
+	if (row == NULL)
+		return false;
+	const int *pixels = RECOIL_GetPixels(recoil);
+	bool ok = true;
+	for (int y = 0; ok && y < height; y++) {
+		RECOIL_ConvertPixels(row, pixels + y * width, width, format);
+		ok = fwrite(row, 1, row_length, fp) == row_length;
+	}
+	free(row);
+	return ok;
+}
+
+bool RECOIL_SavePnm(RECOIL *recoil, FILE *fp)
+{
+	bool ok = fprintf(fp, "P6\n%d %d\n255\n", RECOIL_GetWidth(recoil), RECOIL_GetHeight(recoil)) > 0
+		&& save_rows(recoil, fp, RECOIL_PIXEL_FORMAT_RGB24);
+	return close_file(fp, ok);
+}
+
+bool RECOIL_SavePam(RECOIL *recoil, FILE *fp)
+{
+	bool ok = fprintf(fp, "P7\nWIDTH %d\nHEIGHT %d\nDEPTH 3\nMAXVAL 255\nTUPLTYPE RGB\nENDHDR\n",
+			RECOIL_GetWidth(recoil), RECOIL_GetHeight(recoil)) > 0
+		&& save_rows(recoil, fp, RECOIL_PIXEL_FORMAT_RGB24);
+	return close_file(fp, ok);
+}
+
+bool RECOIL_SaveRgba(RECOIL *recoil, FILE *fp)
+{
+	uint8_t header[12] = { 'R', 'G', 'B', 'A' };
+	put32be(header + 4, RECOIL_GetWidth(recoil));
+	put32be(header + 8, RECOIL_GetHeight(recoil));
+	bool ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header)
+		&& save_rows(recoil, fp, RECOIL_PIXEL_FORMAT_RGBA32);
+	return close_file(fp, ok);
+}
+
+bool RECOIL_SaveBmp(RECOIL *recoil, FILE *fp)
+{
+	int width = RECOIL_GetWidth(recoil);
+	int height = RECOIL_GetHeight(recoil);
+	const int *palette = RECOIL_ToPalette(recoil);
+	int colors = palette == NULL ? 0 : RECOIL_GetColors(recoil);
+	int bit_depth = palette == NULL ? 24
+		: colors <= 2 ? 1
+		: colors <= 16 ? 4
+		: 8;
+	int stride = (width * bit_depth + 31) >> 5 << 2;
+	int bits_offset = 14 + 40 + colors * 4;
+
+	uint8_t header[14 + 40] = { 'B', 'M' };
+	put32le(header + 2, bits_offset + stride * height);
+	put32le(header + 10, bits_offset);
+	put32le(header + 14, 40);
+	put32le(header + 18, width);
+	put32le(header + 22, height);
+	put16le(header + 26, 1);
+	put16le(header + 28, bit_depth);
+	put32le(header + 34, stride * height);
+	put32le(header + 38, RECOIL_GetXPixelsPerMeter(recoil));
+	put32le(header + 42, RECOIL_GetYPixelsPerMeter(recoil));
+	put32le(header + 46, colors);
+	bool ok = fwrite(header, 1, sizeof(header), fp) == sizeof(header);
+	for (int i = 0; ok && i < colors; i++) {
+		uint8_t bgr0[4] = { (uint8_t) palette[i], (uint8_t) (palette[i] >> 8), (uint8_t) (palette[i] >> 16), 0 };
+		ok = fwrite(bgr0, 1, 4, fp) == 4;
+	}
+
+	uint8_t *row = (uint8_t *) calloc(stride, 1);
+	if (row == NULL) {
+		fclose(fp);
+		return false;
+	}
+	const int *pixels = RECOIL_GetPixels(recoil);
+	const uint8_t *indexes = RECOIL_GetIndexes(recoil);
+	// BMP is bottom-up
+	for (int y = height; ok && --y >= 0; ) {
+		switch (bit_depth) {
+		case 24:
+			RECOIL_ConvertPixels(row, pixels + y * width, width, RECOIL_PIXEL_FORMAT_BGR24);
+			break;
+		case 8:
+			memcpy(row, indexes + y * width, width);
+			break;
+		default:
+			memset(row, 0, stride);
+			for (int x = 0; x < width; x++) {
+				int bit = x * bit_depth;
+				row[bit >> 3] |= indexes[y * width + x] << (8 - bit_depth - (bit & 7));
+			}
+			break;
+		}
+		ok = fwrite(row, 1, stride, fp) == stride;
+	}
+	free(row);
+	return close_file(fp, ok);
+}
+
+typedef struct {
+	FILE *fp;
+	bool ok;
+	int length;
+	uint8_t buffer[65536];
+} QoiWriter;
+
+static void qoi_flush(QoiWriter *w)
+{
+	if (w->ok && fwrite(w->buffer, 1, w->length, w->fp) != w->length)
+		w->ok = false;
+	w->length = 0;
+}
+
+static void qoi_put(QoiWriter *w, int b)
+{
+	if (w->length == sizeof(w->buffer))
+		qoi_flush(w);
+	w->buffer[w->length++] = (uint8_t) b;
+}
+
+bool RECOIL_SaveQoi(RECOIL *recoil, FILE *fp)
+{
+	QoiWriter *w = (QoiWriter *) malloc(sizeof(QoiWriter));
+	if (w == NULL) {
+		fclose(fp);
+		return false;
+	}
+	w->fp = fp;
+	w->ok = true;
+	int width = RECOIL_GetWidth(recoil);
+	int height = RECOIL_GetHeight(recoil);
+	memcpy(w->buffer, "qoif", 4);
+	put32be(w->buffer + 4, width);
+	put32be(w->buffer + 8, height);
+	w->buffer[12] = 3; // RGB
+	w->buffer[13] = 0; // sRGB
+	w->length = 14;
+
+	int index[64];
+	// the specification zero-initializes entries with alpha 0, which never match our opaque pixels
+	memset(index, -1, sizeof(index));
+	const int *pixels = RECOIL_GetPixels(recoil);
+	int pixels_length = width * height;
+	int prev = 0;
+	int run = 0;
+	for (int i = 0; i < pixels_length; i++) {
+		int rgb = pixels[i];
+		if (rgb == prev) {
+			if (++run == 62 || i == pixels_length - 1) {
+				qoi_put(w, 0xc0 | (run - 1));
+				run = 0;
+			}
+			continue;
+		}
+		if (run > 0) {
+			qoi_put(w, 0xc0 | (run - 1));
+			run = 0;
+		}
+		int r = rgb >> 16 & 0xff;
+		int g = rgb >> 8 & 0xff;
+		int b = rgb & 0xff;
+		int hash = (r * 3 + g * 5 + b * 7 + 255 * 11) & 63;
+		if (index[hash] == rgb)
+			qoi_put(w, hash);
+		else {
+			index[hash] = rgb;
+			int dr = (int8_t) (r - (prev >> 16 & 0xff));
+			int dg = (int8_t) (g - (prev >> 8 & 0xff));
+			int db = (int8_t) (b - (prev & 0xff));
+			int dr_dg = dr - dg;
+			int db_dg = db - dg;
+			if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+				qoi_put(w, 0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+			else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+				qoi_put(w, 0x80 | (dg + 32));
+				qoi_put(w, (dr_dg + 8) << 4 | (db_dg + 8));
+			}
+			else {
+				qoi_put(w, 0xfe);
+				qoi_put(w, r);
+				qoi_put(w, g);
+				qoi_put(w, b);
+			}
+		}
+		prev = rgb;
+	}
+	for (int i = 0; i < 7; i++)
+		qoi_put(w, 0);
+	qoi_put(w, 1);
+	qoi_flush(w);
+	bool ok = w->ok;
+	free(w);
+	return close_file(fp, ok);
+}
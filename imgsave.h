@@ -0,0 +1,57 @@
+/*
+ * imgsave.h - save PNM, PAM, BMP, raw RGBA and QOI files
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _IMGSAVE_H_
+#define _IMGSAVE_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "recoil.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* All functions close `fp`, like RECOIL_SavePng. */
+
+/* Binary PPM (P6). */
+bool RECOIL_SavePnm(RECOIL *recoil, FILE *fp);
+
+/* PAM (P7) with the RGB tuple type. */
+bool RECOIL_SavePam(RECOIL *recoil, FILE *fp);
+
+/* Uncompressed BMP: 1/4/8-bit palette-indexed if RECOIL_ToPalette succeeds, 24-bit otherwise. */
+bool RECOIL_SaveBmp(RECOIL *recoil, FILE *fp);
+
+/* "RGBA", 32-bit big-endian width and height, then four bytes per pixel with alpha 255. */
+bool RECOIL_SaveRgba(RECOIL *recoil, FILE *fp);
+
+/* Quite OK Image format, three channels. */
+bool RECOIL_SaveQoi(RECOIL *recoil, FILE *fp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -28,7 +28,17 @@
 
 #include "recoil-stdio.h"
 
-static CGImageRef CreateImage(CFURLRef url)
+static bool IsThumbnailCancelled(void *context)
+{
+	return QLThumbnailRequestIsCancelled((QLThumbnailRequestRef) context);
+}
+
+static bool IsPreviewCancelled(void *context)
+{
+	return QLPreviewRequestIsCancelled((QLPreviewRequestRef) context);
+}
+
+static CGImageRef CreateImage(CFURLRef url, bool (*is_cancelled)(void *context), void *request)
 {
 	char filename[FILENAME_MAX];
 	if (!CFURLGetFileSystemRepresentation(url, false, (UInt8 *) filename, sizeof(filename)))
@@ -44,7 +54,9 @@ static CGImageRef CreateImage(CFURLRef url)
 		CFRelease(data);
 		return NULL;
 	}
+	RECOILStdio_SetCancelCallback(is_cancelled, request);
 	bool ok = RECOIL_Decode(recoil, filename, CFDataGetBytePtr(data), CFDataGetLength(data));
+	RECOILStdio_SetCancelCallback(NULL, NULL);
 	CFRelease(data);
 	if (!ok) {
 		RECOIL_Delete(recoil);
@@ -116,7 +128,7 @@ static ULONG Release(void *thisInstance)
 
 static OSStatus GenerateThumbnailForURL(void *thisInstance, QLThumbnailRequestRef thumbnail, CFURLRef url, CFStringRef contentTypeUTI, CFDictionaryRef options, CGSize maxSize)
 {
-	CGImageRef image = CreateImage(url);
+	CGImageRef image = CreateImage(url, IsThumbnailCancelled, (void *) thumbnail);
 	if (image != NULL) {
 		QLThumbnailRequestSetImage(thumbnail, image, NULL);
 		CFRelease(image);
@@ -130,7 +142,7 @@ static void CancelThumbnailGeneration(void* thisInstance, QLThumbnailRequestRef
 
 static OSStatus GeneratePreviewForURL(void *thisInstance, QLPreviewRequestRef preview, CFURLRef url, CFStringRef contentTypeUTI, CFDictionaryRef options)
 {
-	CGImageRef image = CreateImage(url);
+	CGImageRef image = CreateImage(url, IsPreviewCancelled, (void *) preview);
 	if (image == NULL)
 		return noErr;
 
@@ -0,0 +1,157 @@
+#!/usr/bin/perl
+# perf.pl - compare decoding speed against a baseline
+#
+# Copyright (C) 2021  Piotr Fusik
+#
+# This file is part of RECOIL (Retro Computer Image Library),
+# see http://recoil.sourceforge.net
+#
+# RECOIL is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License as published
+# by the Free Software Foundation; either version 2 of the License,
+# or (at your option) any later version.
+#
+# RECOIL is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty
+# of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+# See the GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+# 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+
+# Usage: perl perf.pl [OPTIONS] BASELINE DIRECTORY
+#
+# Runs ./benchmark over all files in DIRECTORY and computes, for every
+# filename extension, the median of the per-file median decoding times.
+# Compares these with BASELINE and fails if any format got slower
+# than the threshold ratio. With --update, writes BASELINE instead.
+
+use strict;
+use warnings;
+
+my $benchmark = './benchmark';
+my $repeat = 10;
+my $threshold = 1.2;
+# ignore differences smaller than this, they are timer noise
+my $min_ns = 20000;
+my $top = 20;
+my $update = 0;
+my @args;
+for (@ARGV) {
+	if (/^--benchmark=(.+)$/) {
+		$benchmark = $1;
+	}
+	elsif (/^--repeat=(\d+)$/) {
+		$repeat = $1;
+	}
+	elsif (/^--threshold=(\d+(?:\.\d+)?)$/) {
+		$threshold = $1;
+	}
+	elsif (/^--min-ns=(\d+)$/) {
+		$min_ns = $1;
+	}
+	elsif (/^--top=(\d+)$/) {
+		$top = $1;
+	}
+	elsif ($_ eq '--update') {
+		$update = 1;
+	}
+	elsif (/^-/) {
+		die "perf.pl: unknown option: $_\n";
+	}
+	else {
+		push @args, $_;
+	}
+}
+die "Usage: perl perf.pl [--update] [--threshold=RATIO] [--min-ns=N] [--top=N] [--repeat=N] [--benchmark=PROGRAM] BASELINE DIRECTORY\n" unless @args == 2;
+my ($baseline_file, $dir) = @args;
+
+# without a baseline there is nothing to compare, so skip the slow benchmark
+my %baseline;
+if (!$update) {
+	if (open my $fh, '<', $baseline_file) {
+		while (<$fh>) {
+			next if /^#/ || !/\S/;
+			my ($ext, $files, $ns) = split /\t/;
+			$baseline{$ext} = $ns;
+		}
+		close $fh;
+	}
+	if (!%baseline) {
+		print "perf.pl: no formats in $baseline_file, skipping the comparison\nRun \"make perf-baseline\" first.\n";
+		exit 0;
+	}
+}
+
+opendir my $dh, $dir or die "$dir: $!\n";
+my @files = sort map "$dir/$_", grep { /\.[^.]+$/ && -f "$dir/$_" } readdir $dh;
+closedir $dh;
+die "perf.pl: no files in $dir\n" unless @files;
+
+sub median {
+	my @sorted = sort { $a <=> $b } @_;
+	my $n = @sorted;
+	return $n % 2 ? $sorted[$n >> 1] : ($sorted[($n >> 1) - 1] + $sorted[$n >> 1]) / 2;
+}
+
+# extension => [ per-file median decoding times ]
+my %times;
+my $errors = 0;
+# run in batches to stay within the command line length limit
+for (my $i = 0; $i < @files; $i += 500) {
+	my $end = $i + 499 < $#files ? $i + 499 : $#files;
+	open my $ph, '-|', $benchmark, '--csv', '--no-png', "--repeat=$repeat", @files[$i .. $end] or die "$benchmark: $!\n";
+	my @columns;
+	while (<$ph>) {
+		chomp;
+		my @fields = map { s/^"(.*)"$/$1/; s/""/"/g; $_ } /("(?:[^"]|"")*"|[^,]*)(?:,|$)/g;
+		if (!@columns) {
+			@columns = @fields;
+			next;
+		}
+		my %row;
+		@row{@columns} = @fields;
+		next unless $row{'record'} eq 'file';
+		if ($row{'error'} ne '') {
+			$errors++;
+			next;
+		}
+		my ($ext) = $row{'file'} =~ /\.([^.\/]+)$/;
+		push @{$times{uc $ext}}, $row{'Decode_median_ns'};
+	}
+	close $ph;
+	# benchmark exits with 1 if any file failed, that's reported above
+	die "$benchmark failed\n" if $? & 127 || !@columns;
+}
+
+my %medians = map { $_ => median(@{$times{$_}}) } keys %times;
+
+if ($update) {
+	open my $fh, '>', $baseline_file or die "$baseline_file: $!\n";
+	print $fh "# Median decoding time in nanoseconds per filename extension, written by perf.pl --update.\n";
+	print $fh "# format\tfiles\tmedian_ns\n";
+	printf $fh "%s\t%d\t%.0f\n", $_, scalar @{$times{$_}}, $medians{$_} for sort keys %medians;
+	close $fh or die "$baseline_file: $!\n";
+	printf "%d formats written to %s\n", scalar keys %medians, $baseline_file;
+	exit 0;
+}
+
+my @compared = grep { exists $baseline{$_} && $baseline{$_} > 0 } sort keys %medians;
+my @regressions = sort { $b->[1] <=> $a->[1] } grep { $_->[1] > 1 }
+	map { [ $_, $medians{$_} / $baseline{$_}, $baseline{$_}, $medians{$_} ] } @compared;
+my @failed = grep { $_->[1] > $threshold && $_->[3] - $_->[2] >= $min_ns } @regressions;
+
+printf "%d formats compared, %d new, %d missing, %d files not decoded\n", scalar @compared,
+	scalar(grep { !exists $baseline{$_} } keys %medians), scalar(grep { !exists $medians{$_} } keys %baseline), $errors;
+if (@regressions) {
+	print "\nTop regressions:\nFormat       Ratio  Baseline ms   Current ms\n";
+	splice @regressions, $top if @regressions > $top;
+	printf "%-10s %6.2fx %12.3f %12.3f%s\n", $_->[0], $_->[1], $_->[2] * 1e-6, $_->[3] * 1e-6,
+		$_->[1] > $threshold && $_->[3] - $_->[2] >= $min_ns ? '  FAIL' : '' for @regressions;
+}
+if (@failed) {
+	printf "\n%d formats slower than %gx the baseline\n", scalar @failed, $threshold;
+	exit 1;
+}
+print "\nNo format slower than ${threshold}x the baseline\n";
@@ -21,22 +21,29 @@
  * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <png.h>
+#include <zlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
 
 #include "pngsave.h"
+#include "recoil-pixels.h"
 
-static void rgb2png(png_colorp dest, const int *src, int length)
+void RECOIL_InitPngOptions(RECOILPngOptions *options)
 {
-	for (int i = 0; i < length; i++) {
-		int rgb = src[i];
-		dest[i].red = (png_byte) (rgb >> 16);
-		dest[i].green = (png_byte) (rgb >> 8);
-		dest[i].blue = (png_byte) rgb;
-	}
+	options->level = RECOIL_PNG_DEFAULT;
+	options->filter = RECOIL_PNG_DEFAULT;
+	options->strategy = RECOIL_PNG_DEFAULT;
+	options->threads = 1;
 }
 
-static bool save_png_rows(const RECOIL *recoil, FILE *fp, int bit_depth, int color_type, png_const_colorp png_palette, int colors, png_bytepp row_pointers)
+static bool save_png_rows(const RECOIL *recoil, FILE *fp, int bit_depth, int color_type, png_const_colorp png_palette, int colors, png_bytepp row_pointers, const RECOILPngOptions *options)
 {
 	png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
 	if (png_ptr == NULL)
@@ -53,6 +60,12 @@ static bool save_png_rows(const RECOIL *recoil, FILE *fp, int bit_depth, int col
 		return false;
 	}
 	png_init_io(png_ptr, fp);
+	if (options->level != RECOIL_PNG_DEFAULT)
+		png_set_compression_level(png_ptr, options->level);
+	if (options->filter != RECOIL_PNG_DEFAULT)
+		png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, options->filter == RECOIL_PNG_FILTER_NONE ? PNG_FILTER_NONE : PNG_ALL_FILTERS);
+	if (options->strategy != RECOIL_PNG_DEFAULT)
+		png_set_compression_strategy(png_ptr, options->strategy);
 	png_set_IHDR(png_ptr, info_ptr, RECOIL_GetWidth(recoil), RECOIL_GetHeight(recoil), bit_depth, color_type,
 		PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 	if (png_palette != NULL)
@@ -69,7 +82,7 @@ static bool save_png_rows(const RECOIL *recoil, FILE *fp, int bit_depth, int col
 	return true;
 }
 
-static bool save_png(const RECOIL *recoil, FILE *fp, int bit_depth, int color_type, png_const_colorp png_palette, int colors, const void *pixels, size_t stride)
+static bool save_png(const RECOIL *recoil, FILE *fp, int bit_depth, int color_type, png_const_colorp png_palette, int colors, const void *pixels, size_t stride, const RECOILPngOptions *options)
 {
 	int height = RECOIL_GetHeight(recoil);
 	png_bytepp row_pointers = (png_bytepp) malloc(height * sizeof(png_bytep));
@@ -77,36 +90,349 @@ static bool save_png(const RECOIL *recoil, FILE *fp, int bit_depth, int color_ty
 		return false;
 	for (int y = 0; y < height; y++)
 		row_pointers[y] = (png_bytep) pixels + y * stride;
-	bool ok = save_png_rows(recoil, fp, bit_depth, color_type, png_palette, colors, row_pointers);
+	bool ok = save_png_rows(recoil, fp, bit_depth, color_type, png_palette, colors, row_pointers, options);
 	free(row_pointers);
 	return ok;
 }
 
-bool RECOIL_SavePng(RECOIL *recoil, FILE *fp)
+/* Multi-threaded encoder: each stripe of rows is filtered and deflated independently
+   and the raw deflate streams are concatenated, like pigz does. */
+
+typedef struct {
+	const RECOIL *recoil;
+	int bit_depth;
+	int row_bytes;
+	int first_row;
+	int end_row;
+	bool adaptive;
+	int level;
+	int strategy;
+	bool last;
+	uint8_t *out;
+	size_t out_length;
+	uLong adler;
+	bool ok;
+} PngStripe;
+
+static void get_png_row(const PngStripe *stripe, int y, uint8_t *dest)
+{
+	int width = RECOIL_GetWidth(stripe->recoil);
+	if (stripe->bit_depth == 24)
+		RECOIL_ConvertPixels(dest, RECOIL_GetPixels(stripe->recoil) + y * width, width, RECOIL_PIXEL_FORMAT_RGB24);
+	else {
+		const uint8_t *src = RECOIL_GetIndexes(stripe->recoil) + y * width;
+		if (stripe->bit_depth == 8)
+			memcpy(dest, src, width);
+		else {
+			memset(dest, 0, stripe->row_bytes);
+			for (int x = 0; x < width; x++) {
+				int bit = x * stripe->bit_depth;
+				dest[bit >> 3] |= src[x] << (8 - stripe->bit_depth - (bit & 7));
+			}
+		}
+	}
+}
+
+static int paeth(int a, int b, int c)
+{
+	int pa = abs(b - c);
+	int pb = abs(a - c);
+	int pc = abs(a + b - 2 * c);
+	return pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+}
+
+/* Writes `filter` followed by the filtered `row` to `dest` and returns the sum of absolute values. */
+static int filter_png_row(uint8_t *dest, int filter, const uint8_t *row, const uint8_t *prev, int row_bytes, int bpp)
+{
+	dest[0] = (uint8_t) filter;
+	int sum = 0;
+	for (int i = 0; i < row_bytes; i++) {
+		int a = i >= bpp ? row[i - bpp] : 0;
+		int b = prev[i];
+		int c = i >= bpp ? prev[i - bpp] : 0;
+		int predicted;
+		switch (filter) {
+		case 1:
+			predicted = a;
+			break;
+		case 2:
+			predicted = b;
+			break;
+		case 3:
+			predicted = (a + b) >> 1;
+			break;
+		case 4:
+			predicted = paeth(a, b, c);
+			break;
+		default:
+			predicted = 0;
+			break;
+		}
+		int8_t d = (int8_t) (row[i] - predicted);
+		dest[1 + i] = (uint8_t) d;
+		sum += abs(d);
+	}
+	return sum;
+}
+
+static void deflate_png_stripe(PngStripe *stripe)
+{
+	int row_bytes = stripe->row_bytes;
+	int bpp = stripe->bit_depth == 24 ? 3 : 1;
+	uint8_t *rows = (uint8_t *) calloc(2 * row_bytes + 2 * (1 + row_bytes), 1);
+	if (rows == NULL)
+		return;
+	uint8_t *prev = rows;
+	uint8_t *row = prev + row_bytes;
+	uint8_t *best = row + row_bytes;
+	uint8_t *candidate = best + 1 + row_bytes;
+	if (stripe->first_row > 0)
+		get_png_row(stripe, stripe->first_row - 1, prev);
+
+	z_stream z;
+	memset(&z, 0, sizeof(z));
+	if (deflateInit2(&z, stripe->level, Z_DEFLATED, -MAX_WBITS, 8, stripe->strategy) != Z_OK) {
+		free(rows);
+		return;
+	}
+	uLong raw_length = (uLong) (stripe->end_row - stripe->first_row) * (1 + row_bytes);
+	// 2 bytes for the zlib header, 4 for Adler-32, 5 for the sync flush
+	size_t capacity = deflateBound(&z, raw_length) + 2 + 4 + 5;
+	stripe->out = (uint8_t *) malloc(capacity);
+	if (stripe->out == NULL) {
+		deflateEnd(&z);
+		free(rows);
+		return;
+	}
+	z.next_out = stripe->out + 2;
+	z.avail_out = (uInt) (capacity - 2 - 4);
+	stripe->adler = adler32(0, NULL, 0);
+	bool ok = true;
+	for (int y = stripe->first_row; ok && y < stripe->end_row; y++) {
+		get_png_row(stripe, y, row);
+		if (stripe->adaptive) {
+			int best_sum = filter_png_row(best, 0, row, prev, row_bytes, bpp);
+			for (int filter = 1; filter <= 4; filter++) {
+				int sum = filter_png_row(candidate, filter, row, prev, row_bytes, bpp);
+				if (sum < best_sum) {
+					best_sum = sum;
+					uint8_t *t = best;
+					best = candidate;
+					candidate = t;
+				}
+			}
+		}
+		else
+			filter_png_row(best, 0, row, prev, row_bytes, bpp);
+		stripe->adler = adler32(stripe->adler, best, 1 + row_bytes);
+		z.next_in = best;
+		z.avail_in = 1 + row_bytes;
+		ok = deflate(&z, Z_NO_FLUSH) == Z_OK && z.avail_in == 0;
+		uint8_t *t = prev;
+		prev = row;
+		row = t;
+	}
+	if (ok)
+		ok = deflate(&z, stripe->last ? Z_FINISH : Z_SYNC_FLUSH) == (stripe->last ? Z_STREAM_END : Z_OK);
+	stripe->out_length = z.next_out - stripe->out;
+	deflateEnd(&z);
+	free(rows);
+	stripe->ok = ok;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI deflate_png_stripe_thread(LPVOID arg)
+{
+	deflate_png_stripe((PngStripe *) arg);
+	return 0;
+}
+#else
+static void *deflate_png_stripe_thread(void *arg)
+{
+	deflate_png_stripe((PngStripe *) arg);
+	return NULL;
+}
+#endif
+
+static void put_png32(uint8_t *p, uLong x)
+{
+	p[0] = (uint8_t) (x >> 24);
+	p[1] = (uint8_t) (x >> 16);
+	p[2] = (uint8_t) (x >> 8);
+	p[3] = (uint8_t) x;
+}
+
+static bool write_png_chunk(FILE *fp, const char *type, const uint8_t *data, size_t length)
+{
+	uint8_t header[8];
+	put_png32(header, length);
+	memcpy(header + 4, type, 4);
+	uLong crc = crc32(0, header + 4, 4);
+	if (length > 0) // crc32 with NULL data returns zero
+		crc = crc32(crc, data, length);
+	uint8_t crc_bytes[4];
+	put_png32(crc_bytes, crc);
+	return fwrite(header, 1, 8, fp) == 8
+		&& fwrite(data, 1, length, fp) == length
+		&& fwrite(crc_bytes, 1, 4, fp) == 4;
+}
+
+static bool save_png_parallel(const RECOIL *recoil, FILE *fp, int bit_depth, const int *palette, int colors, const RECOILPngOptions *options)
+{
+	int width = RECOIL_GetWidth(recoil);
+	int height = RECOIL_GetHeight(recoil);
+	int stripes_count = options->threads < height ? options->threads : height;
+	PngStripe *stripes = (PngStripe *) calloc(stripes_count, sizeof(PngStripe));
+	if (stripes == NULL)
+		return false;
+	bool adaptive = options->filter == RECOIL_PNG_DEFAULT ? bit_depth == 24 : options->filter == RECOIL_PNG_FILTER_ADAPTIVE;
+	int level = options->level == RECOIL_PNG_DEFAULT ? Z_DEFAULT_COMPRESSION : options->level;
+	for (int i = 0; i < stripes_count; i++) {
+		PngStripe *stripe = stripes + i;
+		stripe->recoil = recoil;
+		stripe->bit_depth = bit_depth;
+		stripe->row_bytes = (width * bit_depth + 7) >> 3;
+		stripe->first_row = (int) ((long long) height * i / stripes_count);
+		stripe->end_row = (int) ((long long) height * (i + 1) / stripes_count);
+		stripe->adaptive = adaptive;
+		stripe->level = level;
+		stripe->strategy = options->strategy != RECOIL_PNG_DEFAULT ? options->strategy : adaptive ? Z_FILTERED : Z_DEFAULT_STRATEGY;
+		stripe->last = i == stripes_count - 1;
+	}
+
+	// the calling thread deflates the last stripe
+#ifdef _WIN32
+	HANDLE *threads = (HANDLE *) calloc(stripes_count, sizeof(HANDLE));
+#else
+	pthread_t *threads = (pthread_t *) calloc(stripes_count, sizeof(pthread_t));
+	bool *started = (bool *) calloc(stripes_count, sizeof(bool));
+#endif
+	for (int i = 0; i < stripes_count - 1; i++) {
+#ifdef _WIN32
+		if (threads != NULL)
+			threads[i] = CreateThread(NULL, 0, deflate_png_stripe_thread, stripes + i, 0, NULL);
+		if (threads == NULL || threads[i] == NULL)
+			deflate_png_stripe(stripes + i);
+#else
+		if (threads != NULL && started != NULL)
+			started[i] = pthread_create(threads + i, NULL, deflate_png_stripe_thread, stripes + i) == 0;
+		if (threads == NULL || started == NULL || !started[i])
+			deflate_png_stripe(stripes + i);
+#endif
+	}
+	deflate_png_stripe(stripes + stripes_count - 1);
+	for (int i = 0; i < stripes_count - 1; i++) {
+#ifdef _WIN32
+		if (threads != NULL && threads[i] != NULL) {
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+		}
+#else
+		if (threads != NULL && started != NULL && started[i])
+			pthread_join(threads[i], NULL);
+#endif
+	}
+	free(threads);
+#ifndef _WIN32
+	free(started);
+#endif
+
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	uint8_t ihdr[13];
+	put_png32(ihdr, width);
+	put_png32(ihdr + 4, height);
+	ihdr[8] = (uint8_t) (bit_depth == 24 ? 8 : bit_depth);
+	ihdr[9] = (uint8_t) (bit_depth == 24 ? PNG_COLOR_TYPE_RGB : PNG_COLOR_TYPE_PALETTE);
+	ihdr[10] = PNG_COMPRESSION_TYPE_BASE;
+	ihdr[11] = PNG_FILTER_TYPE_BASE;
+	ihdr[12] = PNG_INTERLACE_NONE;
+	bool ok = fwrite(signature, 1, sizeof(signature), fp) == sizeof(signature)
+		&& write_png_chunk(fp, "IHDR", ihdr, sizeof(ihdr));
+	if (ok && palette != NULL) {
+		uint8_t plte[256 * 3];
+		RECOIL_ConvertPixels(plte, palette, colors, RECOIL_PIXEL_FORMAT_RGB24);
+		ok = write_png_chunk(fp, "PLTE", plte, colors * 3);
+	}
+	int x_ppm = RECOIL_GetXPixelsPerMeter(recoil);
+	if (ok && x_ppm != 0) {
+		uint8_t phys[9];
+		put_png32(phys, x_ppm);
+		put_png32(phys + 4, RECOIL_GetYPixelsPerMeter(recoil));
+		phys[8] = PNG_RESOLUTION_METER;
+		ok = write_png_chunk(fp, "pHYs", phys, sizeof(phys));
+	}
+
+	uLong adler = adler32(0, NULL, 0);
+	for (int i = 0; i < stripes_count; i++) {
+		PngStripe *stripe = stripes + i;
+		ok &= stripe->ok;
+		if (!ok)
+			break;
+		adler = adler32_combine(adler, stripe->adler, (z_off_t) (stripe->end_row - stripe->first_row) * (1 + stripe->row_bytes));
+		uint8_t *data = stripe->out + 2;
+		if (i == 0) {
+			// zlib header: deflate with 32K window, then the compression level hint and check bits
+			int flevel = level == Z_DEFAULT_COMPRESSION ? 2 : level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+			int header = 0x7800 | flevel << 6;
+			header += 31 - header % 31;
+			data -= 2;
+			data[0] = (uint8_t) (header >> 8);
+			data[1] = (uint8_t) header;
+		}
+		size_t length = stripe->out + stripe->out_length - data;
+		if (stripe->last) {
+			put_png32(data + length, adler);
+			length += 4;
+		}
+		ok = write_png_chunk(fp, "IDAT", data, length);
+	}
+	ok = ok && write_png_chunk(fp, "IEND", NULL, 0);
+	for (int i = 0; i < stripes_count; i++)
+		free(stripes[i].out);
+	free(stripes);
+	return ok;
+}
+
+bool RECOIL_SavePngWithOptions(RECOIL *recoil, FILE *fp, const RECOILPngOptions *options)
 {
 	int width = RECOIL_GetWidth(recoil);
 	const int *palette = RECOIL_ToPalette(recoil);
+	int colors = palette == NULL ? 0 : RECOIL_GetColors(recoil);
 	bool ok;
-	if (palette == NULL) {
+	if (options->threads > 1) {
+		int bit_depth = palette == NULL ? 24
+			: colors <= 2 ? 1
+			: colors <= 4 ? 2
+			: colors <= 16 ? 4
+			: 8;
+		ok = save_png_parallel(recoil, fp, bit_depth, palette, colors, options);
+	}
+	else if (palette == NULL) {
 		int pixels_length = width * RECOIL_GetHeight(recoil);
 		png_colorp png_pixels = (png_colorp) malloc(pixels_length * sizeof(png_color));
 		if (png_pixels == NULL) {
 			fclose(fp);
 			return false;
 		}
-		rgb2png(png_pixels, RECOIL_GetPixels(recoil), pixels_length);
-		ok = save_png(recoil, fp, 8, PNG_COLOR_TYPE_RGB, NULL, 0, png_pixels, width * sizeof(png_color));
+		RECOIL_ConvertPixels(png_pixels, RECOIL_GetPixels(recoil), pixels_length, RECOIL_PIXEL_FORMAT_RGB24);
+		ok = save_png(recoil, fp, 8, PNG_COLOR_TYPE_RGB, NULL, 0, png_pixels, width * sizeof(png_color), options);
 		free(png_pixels);
 	}
 	else {
-		int colors = RECOIL_GetColors(recoil);
 		int bit_depth = colors <= 2 ? 1
 			: colors <= 4 ? 2
 			: colors <= 16 ? 4
 			: 8;
 		png_color png_palette[256];
-		rgb2png(png_palette, palette, colors);
-		ok = save_png(recoil, fp, bit_depth, PNG_COLOR_TYPE_PALETTE, png_palette, colors, RECOIL_GetIndexes(recoil), width);
+		RECOIL_ConvertPixels(png_palette, palette, colors, RECOIL_PIXEL_FORMAT_RGB24);
+		ok = save_png(recoil, fp, bit_depth, PNG_COLOR_TYPE_PALETTE, png_palette, colors, RECOIL_GetIndexes(recoil), width, options);
 	}
 	return fclose(fp) == 0 && ok;
 }
+
+bool RECOIL_SavePng(RECOIL *recoil, FILE *fp)
+{
+	RECOILPngOptions options;
+	RECOIL_InitPngOptions(&options);
+	return RECOIL_SavePngWithOptions(recoil, fp, &options);
+}
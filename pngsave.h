@@ -33,8 +33,32 @@
 extern "C" {
 #endif
 
+/* Value of `RECOILPngOptions` fields that selects the libpng default. */
+#define RECOIL_PNG_DEFAULT -1
+
+#define RECOIL_PNG_FILTER_NONE 0
+#define RECOIL_PNG_FILTER_ADAPTIVE 1
+
+typedef struct {
+	/* zlib compression level 0-9. */
+	int level;
+	/* RECOIL_PNG_FILTER_NONE or RECOIL_PNG_FILTER_ADAPTIVE.
+	   The default is none for palette-indexed and adaptive for RGB pictures. */
+	int filter;
+	/* zlib strategy such as Z_FILTERED or Z_RLE.
+	   The default is Z_FILTERED if the rows are filtered and Z_DEFAULT_STRATEGY otherwise. */
+	int strategy;
+	/* Number of horizontal stripes deflated in parallel.
+	   1 uses libpng, otherwise the IDAT stream is stitched from the stripes. */
+	int threads;
+} RECOILPngOptions;
+
+void RECOIL_InitPngOptions(RECOILPngOptions *options);
+
 bool RECOIL_SavePng(RECOIL *recoil, FILE *fp);
 
+bool RECOIL_SavePngWithOptions(RECOIL *recoil, FILE *fp, const RECOILPngOptions *options);
+
 #ifdef __cplusplus
 }
 #endif
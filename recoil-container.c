@@ -0,0 +1,779 @@
+/*
+ * recoil-container.c - enumerate files in disk, tape and ZIP images
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <string.h>
+#include <zlib.h>
+
+#include "recoil-container.h"
+
+static int get16le(const uint8_t *p)
+{
+	return p[0] | p[1] << 8;
+}
+
+static int get24le(const uint8_t *p)
+{
+	return get16le(p) | p[2] << 16;
+}
+
+static int get32le(const uint8_t *p)
+{
+	return get24le(p) | p[3] << 24;
+}
+
+static bool has_ext(const char *filename, const char *ext)
+{
+	const char *dot = strrchr(filename, '.');
+	if (dot == NULL)
+		return false;
+	int i;
+	for (i = 0; ext[i] != '\0' && (dot[1 + i] | 0x20) == (ext[i] | 0x20); i++);
+	return ext[i] == '\0' && dot[1 + i] == '\0';
+}
+
+static void append_name(RECOILContainer *container, int *len, int c)
+{
+	if (*len >= RECOIL_MAX_CONTAINER_NAME_LENGTH)
+		return;
+	// keep the names safe for use as output filenames
+	if (c < ' ' || c > '~' || c == '\\' || c == ':' || c == '*' || c == '?' || c == '"' || c == '<' || c == '>' || c == '|')
+		c = '_';
+	container->name[(*len)++] = (char) c;
+	container->name[*len] = '\0';
+}
+
+static void append_trimmed(RECOILContainer *container, int *len, const uint8_t *s, int s_len)
+{
+	while (s_len > 0 && s[s_len - 1] == ' ')
+		s_len--;
+	for (int i = 0; i < s_len; i++)
+		append_name(container, len, s[i] == '/' ? '_' : s[i]);
+}
+
+// Atari 8-bit: Atari DOS 2 directory in sectors 361-368, 125 or 253 data bytes per sector.
+
+static int get_atari8_sector_len(const RECOILContainer *container, int sector)
+{
+	return sector <= 3 ? container->first_sectors_len : container->sector_len;
+}
+
+static int get_atari8_sector_offset(const RECOILContainer *container, int sector)
+{
+	if (sector < 1)
+		return -1;
+	int offset = container->header_len + (sector <= 3
+		? (sector - 1) * container->first_sectors_len
+		: 3 * container->first_sectors_len + (sector - 4) * container->sector_len);
+	if (offset + get_atari8_sector_len(container, sector) > container->content_len)
+		return -1;
+	return offset;
+}
+
+static bool open_atari8_disk(RECOILContainer *container)
+{
+	const uint8_t *content = container->content;
+	int image_len = container->content_len;
+	if (container->content_len >= 16 && content[0] == 0x96 && content[1] == 0x02) {
+		container->header_len = 16;
+		container->sector_len = get16le(content + 4);
+		if (container->sector_len != 128 && container->sector_len != 256)
+			return false;
+		image_len -= 16;
+	}
+	else {
+		// XFD has no header, the smallest double density image has 128-byte boot sectors
+		container->header_len = 0;
+		container->sector_len = image_len >= 3 * 128 + 717 * 256 ? 256 : 128;
+	}
+	// boot sectors of double density images are usually stored as 128 bytes
+	container->first_sectors_len = image_len % 256 == 0 ? container->sector_len : 128;
+	container->position = 0;
+	return get_atari8_sector_offset(container, 368) >= 0;
+}
+
+static int read_atari8_file(const RECOILContainer *container, uint8_t *buffer, int buffer_len)
+{
+	const uint8_t *content = container->content;
+	int file_no = container->entry_flags >> 8;
+	// MyDOS files have 16-bit sector links instead of file numbers
+	bool mydos = (container->entry_flags & 0x04) != 0;
+	int sector = container->entry_start;
+	int length = 0;
+	for (int i = 0; i < container->remaining; i++) {
+		int offset = get_atari8_sector_offset(container, sector);
+		if (offset < 0)
+			return -1;
+		int trailer = offset + get_atari8_sector_len(container, sector) - 3;
+		int count = content[trailer + 2];
+		if (container->sector_len == 128)
+			count &= 0x7f;
+		if (count > trailer - offset || (!mydos && content[trailer] >> 2 != file_no))
+			return -1;
+		if (buffer != NULL) {
+			if (length + count > buffer_len)
+				return -1;
+			memcpy(buffer + length, content + offset, count);
+		}
+		length += count;
+		sector = mydos ? content[trailer] << 8 | content[trailer + 1] : (content[trailer] & 3) << 8 | content[trailer + 1];
+		if (sector == 0)
+			break;
+	}
+	return length;
+}
+
+static bool next_atari8_entry(RECOILContainer *container)
+{
+	for (; container->position < 64; container->position++) {
+		const uint8_t *entry = container->content + get_atari8_sector_offset(container, 361 + (container->position >> 3)) + (container->position & 7) * 16;
+		int flags = entry[0];
+		if (flags == 0) // never used: end of directory
+			return false;
+		if ((flags & 0x80) != 0 || (flags & 0x40) == 0) // deleted or not in use
+			continue;
+		if ((flags & 0x10) != 0) // MyDOS subdirectory
+			continue;
+		container->entry_flags = container->position << 8 | flags;
+		container->remaining = get16le(entry + 1);
+		container->entry_start = get16le(entry + 3);
+		container->length = read_atari8_file(container, NULL, 0);
+		if (container->length < 0)
+			continue;
+		container->data = container->remaining == 1 ? container->content + get_atari8_sector_offset(container, container->entry_start) : NULL;
+		int len = 0;
+		container->name[0] = '\0';
+		append_trimmed(container, &len, entry + 5, 8);
+		if (entry[13] != ' ') {
+			append_name(container, &len, '.');
+			append_trimmed(container, &len, entry + 13, 3);
+		}
+		container->position++;
+		return true;
+	}
+	return false;
+}
+
+// C64: CBM DOS directory starting at track 18, sector 1, 254 data bytes per sector.
+
+static int get_c64_track_sectors(int track)
+{
+	return track <= 17 ? 21 : track <= 24 ? 19 : track <= 30 ? 18 : 17;
+}
+
+static int get_c64_sector_offset(const RECOILContainer *container, int track, int sector)
+{
+	if (track < 1 || track > container->tracks || sector >= get_c64_track_sectors(track))
+		return -1;
+	for (int t = 1; t < track; t++)
+		sector += get_c64_track_sectors(t);
+	return sector << 8;
+}
+
+static bool open_c64_disk(RECOILContainer *container)
+{
+	switch (container->content_len) {
+	case 174848:
+	case 175531: // with error bytes
+		container->tracks = 35;
+		break;
+	case 196608:
+	case 197376: // with error bytes
+		container->tracks = 40;
+		break;
+	default:
+		return false;
+	}
+	container->position = 18 << 16 | 1 << 8;
+	container->remaining = 19 * 8;
+	return true;
+}
+
+static int read_c64_file(const RECOILContainer *container, uint8_t *buffer, int buffer_len)
+{
+	const uint8_t *content = container->content;
+	int track = container->entry_start >> 8;
+	int sector = container->entry_start & 0xff;
+	int length = 0;
+	// guard against loops in corrupted images
+	for (int i = 0; i < 802 && track != 0; i++) {
+		int offset = get_c64_sector_offset(container, track, sector);
+		if (offset < 0)
+			return -1;
+		track = content[offset];
+		sector = content[offset + 1];
+		int count = track == 0 ? sector - 1 : 254;
+		if (count < 0)
+			return -1;
+		if (buffer != NULL) {
+			if (length + count > buffer_len)
+				return -1;
+			memcpy(buffer + length, content + offset + 2, count);
+		}
+		length += count;
+	}
+	return track == 0 ? length : -1;
+}
+
+static bool next_c64_entry(RECOILContainer *container)
+{
+	const uint8_t *content = container->content;
+	while (container->position != 0 && --container->remaining >= 0) {
+		int offset = get_c64_sector_offset(container, container->position >> 16, container->position >> 8 & 0xff);
+		if (offset < 0)
+			return false;
+		const uint8_t *entry = content + offset + (container->position & 7) * 32;
+		if ((container->position & 7) == 7)
+			container->position = content[offset] << 16 | content[offset + 1] << 8;
+		else
+			container->position++;
+		int type = entry[2];
+		if ((type & 0x80) == 0 || (type & 7) == 0 || (type & 7) > 3) // scratched, DEL or REL
+			continue;
+		container->entry_start = entry[3] << 8 | entry[4];
+		container->length = read_c64_file(container, NULL, 0);
+		int first_offset = get_c64_sector_offset(container, entry[3], entry[4]);
+		if (container->length < 0 || first_offset < 0) // no data sectors (track 0)
+			continue;
+		container->data = content[first_offset] == 0 ? content + first_offset + 2 : NULL;
+		int len = 0;
+		container->name[0] = '\0';
+		// Koala Painter saves its pictures as "\x81PIC ..."
+		bool koala = entry[5] == 0x81;
+		for (int i = koala ? 1 : 0; i < 16 && entry[5 + i] != 0xa0; i++) {
+			int c = entry[5 + i];
+			if (c >= 0xc1 && c <= 0xda) // shifted letters
+				c -= 0x80;
+			append_name(container, &len, c == '/' ? '_' : c);
+		}
+		if (koala && strchr(container->name, '.') == NULL) {
+			append_name(container, &len, '.');
+			append_name(container, &len, 'K');
+			append_name(container, &len, 'O');
+			append_name(container, &len, 'A');
+		}
+		return true;
+	}
+	return false;
+}
+
+// ZX Spectrum: standard header blocks followed by data blocks.
+
+static bool next_zx_tap_block(RECOILContainer *container, int *block_offset, int *block_len)
+{
+	int offset = container->position;
+	if (offset + 2 > container->content_len)
+		return false;
+	*block_len = get16le(container->content + offset);
+	*block_offset = offset + 2;
+	if (*block_offset + *block_len > container->content_len)
+		return false;
+	container->position = *block_offset + *block_len;
+	return true;
+}
+
+static bool next_zx_tzx_block(RECOILContainer *container, int *block_offset, int *block_len)
+{
+	const uint8_t *content = container->content;
+	while (container->position < container->content_len) {
+		int offset = container->position + 1;
+		const uint8_t *p = content + offset;
+		int available = container->content_len - offset;
+		int header_len;
+		int len;
+		bool data = false;
+		switch (content[container->position]) {
+		case 0x10: // standard speed data
+			header_len = 4;
+			if (available < header_len)
+				return false;
+			len = get16le(p + 2);
+			data = true;
+			break;
+		case 0x11: // turbo speed data
+			header_len = 0x12;
+			if (available < header_len)
+				return false;
+			len = get24le(p + 0x0f);
+			data = true;
+			break;
+		case 0x14: // pure data
+			header_len = 0x0a;
+			if (available < header_len)
+				return false;
+			len = get24le(p + 0x07);
+			data = true;
+			break;
+		case 0x12:
+		case 0x2a:
+			header_len = 4;
+			len = 0;
+			break;
+		case 0x13:
+			header_len = 1;
+			len = available < 1 ? 0 : p[0] * 2;
+			break;
+		case 0x15:
+			header_len = 8;
+			if (available < header_len)
+				return false;
+			len = get24le(p + 5);
+			break;
+		case 0x18:
+		case 0x19:
+			header_len = 4;
+			if (available < header_len)
+				return false;
+			len = get32le(p);
+			break;
+		case 0x20:
+		case 0x23:
+		case 0x24:
+			header_len = 2;
+			len = 0;
+			break;
+		case 0x21:
+		case 0x30:
+			header_len = 1;
+			len = available < 1 ? 0 : p[0];
+			break;
+		case 0x22:
+		case 0x25:
+		case 0x27:
+			header_len = 0;
+			len = 0;
+			break;
+		case 0x26:
+			header_len = 2;
+			len = available < 2 ? 0 : get16le(p) * 2;
+			break;
+		case 0x28:
+		case 0x32:
+			header_len = 2;
+			len = available < 2 ? 0 : get16le(p);
+			break;
+		case 0x2b:
+			header_len = 5;
+			len = 0;
+			break;
+		case 0x31:
+			header_len = 2;
+			len = available < 2 ? 0 : p[1];
+			break;
+		case 0x33:
+			header_len = 1;
+			len = available < 1 ? 0 : p[0] * 3;
+			break;
+		case 0x35:
+			header_len = 0x14;
+			if (available < header_len)
+				return false;
+			len = get32le(p + 0x10);
+			break;
+		case 0x5a: // glued TZX
+			header_len = 9;
+			len = 0;
+			break;
+		default:
+			return false;
+		}
+		if (len < 0 || len > available - header_len)
+			return false;
+		container->position = offset + header_len + len;
+		if (data) {
+			*block_offset = offset + header_len;
+			*block_len = len;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool open_zx_tape(RECOILContainer *container)
+{
+	if (container->type == RECOIL_CONTAINER_ZX_TZX) {
+		if (container->content_len < 10 || memcmp(container->content, "ZXTape!\x1a", 8) != 0)
+			return false;
+		container->position = 10;
+	}
+	else {
+		// C64 tapes are raw pulses
+		if (container->content_len >= 12 && memcmp(container->content, "C64-TAPE-RAW", 12) == 0)
+			return false;
+		container->position = 0;
+	}
+	return true;
+}
+
+static bool next_zx_entry(RECOILContainer *container)
+{
+	const uint8_t *content = container->content;
+	int header = -1;
+	int block_offset;
+	int block_len;
+	while (container->type == RECOIL_CONTAINER_ZX_TZX
+		? next_zx_tzx_block(container, &block_offset, &block_len)
+		: next_zx_tap_block(container, &block_offset, &block_len)) {
+		// flag byte, data and checksum
+		if (block_len < 2)
+			continue;
+		if (content[block_offset] == 0 && block_len == 19) {
+			header = block_offset;
+			continue;
+		}
+		container->data = content + block_offset + 1;
+		container->length = block_len - 2;
+		int len = 0;
+		container->name[0] = '\0';
+		if (header >= 0) {
+			append_trimmed(container, &len, content + header + 2, 10);
+			// a "Bytes" file of screen size is a SCREEN$
+			if (content[header + 1] == 3 && container->length == 6912 && strchr(container->name, '.') == NULL) {
+				append_name(container, &len, '.');
+				append_name(container, &len, 'S');
+				append_name(container, &len, 'C');
+				append_name(container, &len, 'R');
+			}
+		}
+		else {
+			static const char headerless[] = "headerless";
+			for (int i = 0; headerless[i] != '\0'; i++)
+				append_name(container, &len, headerless[i]);
+		}
+		return true;
+	}
+	return false;
+}
+
+// Atari ST: FAT12 file system with subdirectories.
+
+static int get_st_cluster_offset(const RECOILContainer *container, int cluster)
+{
+	if (cluster < 2)
+		return -1;
+	int offset = container->data_offset + (cluster - 2) * container->cluster_len;
+	if (offset + container->cluster_len > container->content_len)
+		return -1;
+	return offset;
+}
+
+static int get_st_next_cluster(const RECOILContainer *container, int cluster)
+{
+	int offset = container->fat_offset + cluster * 3 / 2;
+	if (offset + 2 > container->content_len)
+		return -1;
+	int value = get16le(container->content + offset);
+	return (cluster & 1) == 0 ? value & 0xfff : value >> 4;
+}
+
+static bool open_st_disk(RECOILContainer *container)
+{
+	const uint8_t *content = container->content;
+	if (container->content_len < 512)
+		return false;
+	int sector_len = get16le(content + 11);
+	int sectors_per_cluster = content[13];
+	int reserved_sectors = get16le(content + 14);
+	int fats = content[16];
+	int root_entries = get16le(content + 17);
+	int sectors_per_fat = get16le(content + 22);
+	if ((sector_len != 512 && sector_len != 1024) || sectors_per_cluster == 0 || sectors_per_cluster > 8
+	 || fats == 0 || fats > 2 || root_entries == 0 || sectors_per_fat == 0)
+		return false;
+	if (reserved_sectors == 0)
+		reserved_sectors = 1;
+	container->cluster_len = sectors_per_cluster * sector_len;
+	container->fat_offset = reserved_sectors * sector_len;
+	container->root_offset = container->fat_offset + fats * sectors_per_fat * sector_len;
+	container->root_entries = root_entries;
+	container->data_offset = container->root_offset + (root_entries * 32 + sector_len - 1) / sector_len * sector_len;
+	if (container->data_offset > container->content_len)
+		return false;
+	container->depth = 0;
+	container->dir_cluster[0] = 0;
+	container->dir_index[0] = 0;
+	container->dir_path_len[0] = 0;
+	container->path[0] = '\0';
+	container->remaining = 65536;
+	return true;
+}
+
+static int read_st_file(const RECOILContainer *container, uint8_t *buffer, bool *contiguous)
+{
+	int cluster = container->entry_start;
+	*contiguous = true;
+	for (int offset = 0; offset < container->length; offset += container->cluster_len) {
+		if (offset > 0) {
+			int next = get_st_next_cluster(container, cluster);
+			if (next != cluster + 1)
+				*contiguous = false;
+			cluster = next;
+		}
+		int cluster_offset = get_st_cluster_offset(container, cluster);
+		if (cluster_offset < 0)
+			return -1;
+		if (buffer != NULL) {
+			int count = container->length - offset;
+			if (count > container->cluster_len)
+				count = container->cluster_len;
+			memcpy(buffer + offset, container->content + cluster_offset, count);
+		}
+	}
+	return container->length;
+}
+
+static bool next_st_entry(RECOILContainer *container)
+{
+	const uint8_t *content = container->content;
+	// guard against loops in corrupted images
+	while (--container->remaining >= 0) {
+		int depth = container->depth;
+		int cluster = container->dir_cluster[depth];
+		int index = container->dir_index[depth];
+		int entry_offset;
+		if (cluster == 0) {
+			if (index >= container->root_entries)
+				return false;
+			entry_offset = container->root_offset + index * 32;
+		}
+		else {
+			if (index == container->cluster_len / 32) {
+				cluster = get_st_next_cluster(container, cluster);
+				container->dir_cluster[depth] = cluster;
+				container->dir_index[depth] = index = 0;
+			}
+			entry_offset = get_st_cluster_offset(container, cluster);
+			if (entry_offset < 0 || cluster >= 0xff0) {
+				// end of subdirectory
+				container->path[container->dir_path_len[--container->depth]] = '\0';
+				continue;
+			}
+			entry_offset += index * 32;
+		}
+		if (entry_offset + 32 > container->content_len)
+			return false;
+		container->dir_index[depth]++;
+		const uint8_t *entry = content + entry_offset;
+		if (entry[0] == 0) {
+			if (depth == 0)
+				return false;
+			container->path[container->dir_path_len[--container->depth]] = '\0';
+			continue;
+		}
+		if (entry[0] == 0xe5 || entry[0] == '.' || (entry[11] & 0x08) != 0) // deleted, "." and "..", volume label
+			continue;
+
+		int len = 0;
+		container->name[0] = '\0';
+		for (int i = 0; container->path[i] != '\0'; i++)
+			append_name(container, &len, container->path[i]);
+		append_trimmed(container, &len, entry, 8);
+		if (entry[8] != ' ') {
+			append_name(container, &len, '.');
+			append_trimmed(container, &len, entry + 8, 3);
+		}
+		container->entry_start = get16le(entry + 26);
+		if ((entry[11] & 0x10) != 0) {
+			if (depth + 1 < RECOIL_MAX_CONTAINER_DEPTH && len + 1 < RECOIL_MAX_CONTAINER_NAME_LENGTH) {
+				append_name(container, &len, '/');
+				memcpy(container->path, container->name, len + 1);
+				container->depth = ++depth;
+				container->dir_cluster[depth] = container->entry_start;
+				container->dir_index[depth] = 0;
+				container->dir_path_len[depth] = len;
+			}
+			continue;
+		}
+		container->length = get32le(entry + 28);
+		bool contiguous;
+		if (container->length < 0 || read_st_file(container, NULL, &contiguous) < 0)
+			continue;
+		container->data = contiguous && container->length > 0 ? content + get_st_cluster_offset(container, container->entry_start) : NULL;
+		return true;
+	}
+	return false;
+}
+
+// ZIP: central directory.
+
+static bool open_zip(RECOILContainer *container)
+{
+	const uint8_t *content = container->content;
+	for (int offset = container->content_len - 22; offset >= 0 && offset >= container->content_len - 22 - 65535; offset--) {
+		if (memcmp(content + offset, "PK\5\6", 4) == 0) {
+			container->position = get32le(content + offset + 16);
+			container->remaining = get16le(content + offset + 10);
+			return container->position >= 0 && container->position <= offset;
+		}
+	}
+	return false;
+}
+
+static bool next_zip_entry(RECOILContainer *container)
+{
+	const uint8_t *content = container->content;
+	while (--container->remaining >= 0) {
+		int offset = container->position;
+		if (offset + 46 > container->content_len || memcmp(content + offset, "PK\1\2", 4) != 0)
+			return false;
+		const uint8_t *entry = content + offset;
+		int flags = get16le(entry + 8);
+		int method = get16le(entry + 10);
+		int compressed_len = get32le(entry + 20);
+		int name_len = get16le(entry + 28);
+		int local_offset = get32le(entry + 42);
+		container->position = offset + 46 + name_len + get16le(entry + 30) + get16le(entry + 32);
+		if (offset + 46 + name_len > container->content_len)
+			return false;
+		if (name_len == 0 || entry[46 + name_len - 1] == '/' // directory
+		 || (flags & 1) != 0 // encrypted
+		 || (method != 0 && method != 8)
+		 || compressed_len < 0
+		 || local_offset < 0 || local_offset > container->content_len - 30 - compressed_len
+		 || memcmp(content + local_offset, "PK\3\4", 4) != 0)
+			continue;
+		// compare without adding, so that nothing overflows
+		int header_extra_len = get16le(content + local_offset + 26) + get16le(content + local_offset + 28);
+		container->length = get32le(entry + 24);
+		if (container->length < 0 || header_extra_len > container->content_len - 30 - compressed_len - local_offset
+		 || (method == 0 && compressed_len != container->length))
+			continue;
+		int data_offset = local_offset + 30 + header_extra_len;
+		container->entry_start = data_offset;
+		container->entry_flags = compressed_len;
+		container->data = method == 0 ? content + data_offset : NULL;
+		int len = 0;
+		container->name[0] = '\0';
+		// keep the end of very long names, with the extension
+		for (int i = name_len > RECOIL_MAX_CONTAINER_NAME_LENGTH ? name_len - RECOIL_MAX_CONTAINER_NAME_LENGTH : 0; i < name_len; i++)
+			append_name(container, &len, entry[46 + i]);
+		return true;
+	}
+	return false;
+}
+
+static bool inflate_zip_entry(const RECOILContainer *container, uint8_t *buffer)
+{
+	z_stream stream;
+	memset(&stream, 0, sizeof(stream));
+	if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+		return false;
+	stream.next_in = (Bytef *) (container->content + container->entry_start);
+	stream.avail_in = container->entry_flags;
+	stream.next_out = buffer;
+	stream.avail_out = container->length;
+	bool ok = inflate(&stream, Z_FINISH) == Z_STREAM_END && stream.total_out == container->length;
+	inflateEnd(&stream);
+	return ok;
+}
+
+bool RECOIL_OpenContainer(RECOILContainer *container, const char *filename, const uint8_t *content, int content_len)
+{
+	container->content = content;
+	container->content_len = content_len;
+	container->name[0] = '\0';
+	container->length = 0;
+	container->data = NULL;
+	if (has_ext(filename, "atr") || has_ext(filename, "xfd")) {
+		container->type = RECOIL_CONTAINER_ATARI8_DISK;
+		return open_atari8_disk(container);
+	}
+	if (has_ext(filename, "d64")) {
+		container->type = RECOIL_CONTAINER_C64_DISK;
+		return open_c64_disk(container);
+	}
+	if (has_ext(filename, "tap")) {
+		container->type = RECOIL_CONTAINER_ZX_TAP;
+		return open_zx_tape(container);
+	}
+	if (has_ext(filename, "tzx")) {
+		container->type = RECOIL_CONTAINER_ZX_TZX;
+		return open_zx_tape(container);
+	}
+	if (has_ext(filename, "st")) {
+		container->type = RECOIL_CONTAINER_ST_DISK;
+		return open_st_disk(container);
+	}
+	if (has_ext(filename, "zip")) {
+		container->type = RECOIL_CONTAINER_ZIP;
+		return open_zip(container);
+	}
+	return false;
+}
+
+bool RECOIL_NextContainerEntry(RECOILContainer *container)
+{
+	switch (container->type) {
+	case RECOIL_CONTAINER_ATARI8_DISK:
+		return next_atari8_entry(container);
+	case RECOIL_CONTAINER_C64_DISK:
+		return next_c64_entry(container);
+	case RECOIL_CONTAINER_ZX_TAP:
+	case RECOIL_CONTAINER_ZX_TZX:
+		return next_zx_entry(container);
+	case RECOIL_CONTAINER_ST_DISK:
+		return next_st_entry(container);
+	case RECOIL_CONTAINER_ZIP:
+		return next_zip_entry(container);
+	default:
+		return false;
+	}
+}
+
+const uint8_t *RECOIL_GetContainerEntry(RECOILContainer *container, uint8_t *buffer, int buffer_len)
+{
+	if (container->data != NULL)
+		return container->data;
+	if (container->length > buffer_len)
+		return NULL;
+	bool ok;
+	switch (container->type) {
+	case RECOIL_CONTAINER_ATARI8_DISK:
+		ok = read_atari8_file(container, buffer, buffer_len) == container->length;
+		break;
+	case RECOIL_CONTAINER_C64_DISK:
+		ok = read_c64_file(container, buffer, buffer_len) == container->length;
+		break;
+	case RECOIL_CONTAINER_ST_DISK:
+		{
+			bool contiguous;
+			ok = read_st_file(container, buffer, &contiguous) == container->length;
+		}
+		break;
+	case RECOIL_CONTAINER_ZIP:
+		ok = inflate_zip_entry(container, buffer);
+		break;
+	default:
+		// empty entries
+		ok = true;
+		break;
+	}
+	return ok ? buffer : NULL;
+}
+
+bool RECOIL_DecodeContainerEntry(RECOIL *recoil, RECOILContainer *container, uint8_t *buffer)
+{
+	if (container->length > RECOIL_MAX_CONTENT_LENGTH || !RECOIL_IsOurFile(container->name))
+		return false;
+	const uint8_t *content = RECOIL_GetContainerEntry(container, buffer, RECOIL_MAX_CONTENT_LENGTH);
+	return content != NULL && RECOIL_Decode(recoil, container->name, content, container->length);
+}
@@ -0,0 +1,112 @@
+/*
+ * recoil-container.h - enumerate files in disk, tape and ZIP images
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _RECOILCONTAINER_H_
+#define _RECOILCONTAINER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "recoil.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	/* ATR or XFD with Atari DOS 2 or MyDOS. */
+	RECOIL_CONTAINER_ATARI8_DISK,
+	/* D64 with CBM DOS. */
+	RECOIL_CONTAINER_C64_DISK,
+	/* ZX Spectrum TAP. */
+	RECOIL_CONTAINER_ZX_TAP,
+	/* ZX Spectrum TZX. */
+	RECOIL_CONTAINER_ZX_TZX,
+	/* Atari ST raw floppy image with a FAT12 file system. */
+	RECOIL_CONTAINER_ST_DISK,
+	/* ZIP archive with stored or deflated files. */
+	RECOIL_CONTAINER_ZIP
+} RECOILContainerType;
+
+#define RECOIL_MAX_CONTAINER_NAME_LENGTH 255
+#define RECOIL_MAX_CONTAINER_DEPTH 8
+
+typedef struct {
+	RECOILContainerType type;
+	const uint8_t *content;
+	int content_len;
+
+	/* Current entry, valid after RECOIL_NextContainerEntry returns true. */
+	/* Entry name, including the directory path, if any. */
+	char name[RECOIL_MAX_CONTAINER_NAME_LENGTH + 1];
+	/* Entry length. */
+	int length;
+	/* Entry contents if stored contiguously in `content`, NULL otherwise. */
+	const uint8_t *data;
+
+	/* Private: geometry. */
+	int header_len;
+	int sector_len;
+	int first_sectors_len;
+	int tracks;
+	int cluster_len;
+	int fat_offset;
+	int root_offset;
+	int root_entries;
+	int data_offset;
+	/* Private: position. */
+	int position;
+	int remaining;
+	int entry_start;
+	int entry_flags;
+	int depth;
+	int dir_cluster[RECOIL_MAX_CONTAINER_DEPTH];
+	int dir_index[RECOIL_MAX_CONTAINER_DEPTH];
+	int dir_path_len[RECOIL_MAX_CONTAINER_DEPTH];
+	char path[RECOIL_MAX_CONTAINER_NAME_LENGTH + 1];
+} RECOILContainer;
+
+/* Recognizes a container by the filename extension and its contents.
+   `content` must stay unchanged while the container is in use.
+   Returns false if the file is not a supported container. */
+bool RECOIL_OpenContainer(RECOILContainer *container, const char *filename, const uint8_t *content, int content_len);
+
+/* Advances to the next file in the container.
+   Returns false if there are no more files. */
+bool RECOIL_NextContainerEntry(RECOILContainer *container);
+
+/* Returns the contents of the current entry: `data` if the entry is stored contiguously,
+   otherwise the entry is assembled from sectors or inflated into `buffer`.
+   Returns NULL on error or if the entry is longer than `buffer_len`. */
+const uint8_t *RECOIL_GetContainerEntry(RECOILContainer *container, uint8_t *buffer, int buffer_len);
+
+/* Decodes the current entry if its name is recognized by RECOIL_IsOurFile.
+   `buffer` must be RECOIL_MAX_CONTENT_LENGTH bytes long.
+   Returns true on success. */
+bool RECOIL_DecodeContainerEntry(RECOIL *recoil, RECOILContainer *container, uint8_t *buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
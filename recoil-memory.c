@@ -0,0 +1,171 @@
+/*
+ * recoil-memory.c - RECOIL with heap and stack usage measurement
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+/* Compile this file instead of recoil.c. It includes recoil.c
+   with the heap functions redirected to the counting ones below. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "recoil-memory.h"
+
+#if defined(__GNUC__) || defined(__clang__)
+#define RECOIL_NOINLINE __attribute__((noinline))
+/* recoil.c may not call all of the heap functions */
+#define RECOIL_MAYBE_UNUSED __attribute__((unused))
+#elif defined(_MSC_VER)
+#define RECOIL_NOINLINE __declspec(noinline)
+#define RECOIL_MAYBE_UNUSED
+#else
+#define RECOIL_NOINLINE
+#define RECOIL_MAYBE_UNUSED
+#endif
+
+#define STACK_FILL 0xa5
+
+/* Precedes every block, keeps the block aligned. */
+typedef union {
+	size_t size;
+	long double align1;
+	void *align2;
+	int64_t align3;
+} BlockHeader;
+
+static int allocations = 0;
+static int64_t allocated_bytes = 0;
+static int64_t heap_used = 0;
+static int64_t heap_peak = 0;
+
+RECOIL_MAYBE_UNUSED static void *RECOILMemory_Malloc(size_t size)
+{
+	BlockHeader *header = (BlockHeader *) malloc(sizeof(BlockHeader) + size);
+	if (header == NULL)
+		return NULL;
+	header->size = size;
+	allocations++;
+	allocated_bytes += size;
+	heap_used += size;
+	if (heap_peak < heap_used)
+		heap_peak = heap_used;
+	return header + 1;
+}
+
+RECOIL_MAYBE_UNUSED static void *RECOILMemory_Calloc(size_t count, size_t size)
+{
+	if (size != 0 && count > (SIZE_MAX - sizeof(BlockHeader)) / size)
+		return NULL;
+	void *p = RECOILMemory_Malloc(count * size);
+	if (p != NULL)
+		memset(p, 0, count * size);
+	return p;
+}
+
+RECOIL_MAYBE_UNUSED static void RECOILMemory_Free(void *p)
+{
+	if (p == NULL)
+		return;
+	BlockHeader *header = (BlockHeader *) p - 1;
+	heap_used -= header->size;
+	free(header);
+}
+
+RECOIL_MAYBE_UNUSED static void *RECOILMemory_Realloc(void *p, size_t size)
+{
+	if (p == NULL)
+		return RECOILMemory_Malloc(size);
+	BlockHeader *header = (BlockHeader *) p - 1;
+	size_t old_size = header->size;
+	header = (BlockHeader *) realloc(header, sizeof(BlockHeader) + size);
+	if (header == NULL)
+		return NULL;
+	header->size = size;
+	allocations++;
+	allocated_bytes += size;
+	heap_used += (int64_t) size - (int64_t) old_size;
+	if (heap_peak < heap_used)
+		heap_peak = heap_used;
+	return header + 1;
+}
+
+RECOIL_MAYBE_UNUSED static char *RECOILMemory_Strdup(const char *s)
+{
+	size_t len = strlen(s) + 1;
+	char *p = (char *) RECOILMemory_Malloc(len);
+	if (p != NULL)
+		memcpy(p, s, len);
+	return p;
+}
+
+/* Lowest address filled by fill_stack. */
+static uintptr_t stack_bottom;
+
+static RECOIL_NOINLINE void fill_stack(void)
+{
+	volatile uint8_t stack[RECOIL_MEMORY_STACK_LENGTH];
+	for (int i = 0; i < RECOIL_MEMORY_STACK_LENGTH; i++)
+		stack[i] = STACK_FILL;
+	stack_bottom = (uintptr_t) stack;
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+static RECOIL_NOINLINE int scan_stack(void)
+{
+	// Reads what RECOIL left in the stack area filled by fill_stack,
+	// which may start at a slightly different offset in this frame.
+	// Assumes the stack grows down.
+	volatile uint8_t stack[RECOIL_MEMORY_STACK_LENGTH];
+	uintptr_t base = (uintptr_t) stack;
+	int i = base < stack_bottom ? (int) (stack_bottom - base) : 0;
+	while (i < RECOIL_MEMORY_STACK_LENGTH && stack[i] == STACK_FILL)
+		i++;
+	return (int) (stack_bottom + RECOIL_MEMORY_STACK_LENGTH - (base + i));
+}
+
+void RECOILMemory_Start(void)
+{
+	allocations = 0;
+	allocated_bytes = 0;
+	heap_peak = heap_used;
+	fill_stack();
+}
+
+void RECOILMemory_Stop(RECOILMemoryStats *stats)
+{
+	stats->stack_peak = scan_stack();
+	stats->allocations = allocations;
+	stats->bytes = allocated_bytes;
+	stats->heap_peak = heap_peak;
+}
+
+#define malloc RECOILMemory_Malloc
+#define calloc RECOILMemory_Calloc
+#define realloc RECOILMemory_Realloc
+#define free RECOILMemory_Free
+#define strdup RECOILMemory_Strdup
+
+#include "recoil.c"
@@ -0,0 +1,63 @@
+/*
+ * recoil-memory.h - heap and stack usage of RECOIL
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _RECOILMEMORY_H_
+#define _RECOILMEMORY_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Stack bytes checked by RECOILMemory_Stop. */
+#define RECOIL_MEMORY_STACK_LENGTH (512 * 1024)
+
+typedef struct {
+	/* Number of heap blocks allocated. */
+	int allocations;
+	/* Total bytes of these blocks. */
+	int64_t bytes;
+	/* Maximum bytes in use on the heap, including blocks allocated before RECOILMemory_Start. */
+	int64_t heap_peak;
+	/* Approximate maximum stack depth below the caller, RECOIL_MEMORY_STACK_LENGTH if exceeded. */
+	int stack_peak;
+} RECOILMemoryStats;
+
+/**
+ * Starts measuring memory used by RECOIL.
+ * Only works if RECOIL was compiled from recoil-memory.c instead of recoil.c.
+ * Call RECOILMemory_Stop from the same function.
+ */
+void RECOILMemory_Start(void);
+
+/**
+ * Stops measuring memory and returns the usage since RECOILMemory_Start.
+ */
+void RECOILMemory_Stop(RECOILMemoryStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
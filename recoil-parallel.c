@@ -0,0 +1,162 @@
+/*
+ * recoil-parallel.c - decoding of one picture in several threads
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdlib.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "recoil-parallel.h"
+#include "recoil-stdio.h"
+
+typedef struct {
+	RECOIL *recoil;
+	const char *filename;
+	const uint8_t *content;
+	int content_len;
+	bool (*is_cancelled)(void *context);
+	void *cancel_context;
+	bool ok;
+} DecodeStripe;
+
+static void decode_stripe(DecodeStripe *stripe)
+{
+	// the cancel callback is per thread
+	RECOILStdio_SetCancelCallback(stripe->is_cancelled, stripe->cancel_context);
+	stripe->ok = RECOIL_Decode(stripe->recoil, stripe->filename, stripe->content, stripe->content_len);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI decode_stripe_thread(LPVOID arg)
+{
+	decode_stripe((DecodeStripe *) arg);
+	return 0;
+}
+#else
+static void *decode_stripe_thread(void *arg)
+{
+	decode_stripe((DecodeStripe *) arg);
+	return NULL;
+}
+#endif
+
+bool RECOIL_DecodeParallel(RECOIL *recoil, const char *filename, const uint8_t *content, int content_len,
+	RECOIL * const *workers, int workers_count, int min_pixels)
+{
+	// probe the header to skip the row range pre-pass for small pictures
+	if (workers_count <= 0
+	 || RECOIL_Probe(recoil, filename, content, content_len, content_len) != RECOILProbeResult_ACCEPTED
+	 || (long long) RECOIL_GetWidth(recoil) * RECOIL_GetHeight(recoil) < min_pixels)
+		return RECOIL_Decode(recoil, filename, content, content_len);
+	// decode no rows to find out whether the format honors the row range
+	RECOIL_SetRowRange(recoil, 0, 0);
+	bool ok = RECOIL_Decode(recoil, filename, content, content_len);
+	RECOIL_ClearRowRange(recoil);
+	if (!ok)
+		return false;
+	int scale = RECOIL_GetRowRangeScale(recoil);
+	if (scale == 0)
+		return true; // the whole picture was decoded
+	int width = RECOIL_GetWidth(recoil);
+	int height = RECOIL_GetHeight(recoil);
+	int rows = height / scale;
+	int stripes_count = workers_count < rows ? workers_count + 1 : rows;
+	DecodeStripe *stripes = stripes_count <= 1 || (long long) width * height < min_pixels ? NULL
+		: (DecodeStripe *) calloc(stripes_count, sizeof(DecodeStripe));
+	if (stripes == NULL)
+		return RECOIL_Decode(recoil, filename, content, content_len);
+	bool (*is_cancelled)(void *context);
+	void *cancel_context;
+	RECOILStdio_GetCancelCallback(&is_cancelled, &cancel_context);
+	for (int i = 0; i < stripes_count; i++) {
+		DecodeStripe *stripe = stripes + i;
+		stripe->recoil = i == stripes_count - 1 ? recoil : workers[i];
+		stripe->filename = filename;
+		stripe->content = content;
+		stripe->content_len = content_len;
+		stripe->is_cancelled = is_cancelled;
+		stripe->cancel_context = cancel_context;
+		if (stripe->recoil != recoil) {
+			RECOIL_SetNtsc(stripe->recoil, RECOIL_IsNtsc(recoil));
+			RECOIL_SetWorkBudget(stripe->recoil, RECOIL_GetWorkBudget(recoil));
+		}
+		RECOIL_SetRowRange(stripe->recoil, (int) ((long long) rows * i / stripes_count), (int) ((long long) rows * (i + 1) / stripes_count));
+	}
+
+	// the calling thread decodes the last stripe
+#ifdef _WIN32
+	HANDLE *threads = (HANDLE *) calloc(stripes_count, sizeof(HANDLE));
+#else
+	pthread_t *threads = (pthread_t *) calloc(stripes_count, sizeof(pthread_t));
+	bool *started = (bool *) calloc(stripes_count, sizeof(bool));
+#endif
+	for (int i = 0; i < stripes_count - 1; i++) {
+#ifdef _WIN32
+		if (threads != NULL)
+			threads[i] = CreateThread(NULL, 0, decode_stripe_thread, stripes + i, 0, NULL);
+		if (threads == NULL || threads[i] == NULL)
+			decode_stripe(stripes + i);
+#else
+		if (threads != NULL && started != NULL)
+			started[i] = pthread_create(threads + i, NULL, decode_stripe_thread, stripes + i) == 0;
+		if (threads == NULL || started == NULL || !started[i])
+			decode_stripe(stripes + i);
+#endif
+	}
+	decode_stripe(stripes + stripes_count - 1);
+	for (int i = 0; i < stripes_count - 1; i++) {
+#ifdef _WIN32
+		if (threads != NULL && threads[i] != NULL) {
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+		}
+#else
+		if (threads != NULL && started != NULL && started[i])
+			pthread_join(threads[i], NULL);
+#endif
+	}
+	free(threads);
+#ifndef _WIN32
+	free(started);
+#endif
+
+	// stripes are copied in order, so the result does not depend on thread timing
+	RECOIL_ClearRowRange(recoil);
+	ok = stripes[stripes_count - 1].ok;
+	bool complete = ok;
+	for (int i = 0; i < stripes_count - 1; i++) {
+		RECOIL *worker = stripes[i].recoil;
+		if (complete && stripes[i].ok && RECOIL_GetRowRangeScale(worker) == scale
+		 && RECOIL_GetWidth(worker) == width && RECOIL_GetHeight(worker) == height)
+			RECOIL_CopyRowRange(recoil, worker);
+		else
+			complete = false;
+		RECOIL_ClearRowRange(worker);
+	}
+	free(stripes);
+	if (ok && !complete)
+		ok = RECOIL_Decode(recoil, filename, content, content_len);
+	return ok;
+}
@@ -0,0 +1,58 @@
+/*
+ * recoil-parallel.h - decoding of one picture in several threads
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _RECOILPARALLEL_H_
+#define _RECOILPARALLEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "recoil.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Suggested `min_pixels` for RECOIL_DecodeParallel.
+   Smaller pictures decode faster than the threads start. */
+#define RECOIL_PARALLEL_MIN_PIXELS (512 * 1024)
+
+/* Decodes a picture file like RECOIL_Decode, splitting the rows among threads
+   for formats that decode each row independently.
+   `workers` are `workers_count` other decoders constructed the same way as `recoil`,
+   for example with RECOILStdio_New, so that they can read companion files.
+   Each worker decodes a horizontal stripe in its own thread
+   and the calling thread decodes the last stripe with `recoil`.
+   The workers take the NTSC and work budget settings of `recoil`
+   and the RECOILStdio_SetCancelCallback of the calling thread.
+   RECOIL_Probe checks the picture size first,
+   and pictures smaller than `min_pixels` are decoded by `recoil` alone.
+   The decoded picture is identical to RECOIL_Decode. */
+bool RECOIL_DecodeParallel(RECOIL *recoil, const char *filename, const uint8_t *content, int content_len,
+	RECOIL * const *workers, int workers_count, int min_pixels);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * recoil-pixels.c - conversion of decoded pixels to common pixel formats
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "recoil-pixels.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RECOIL_PIXELS_SSSE3
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define RECOIL_PIXELS_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#ifdef RECOIL_PIXELS_SSSE3
+
+/* `src` is read as little-endian B, G, R, 0 quadruples.
+   Returns the number of converted pixels, a multiple of 16. */
+__attribute__((target("ssse3")))
+static int convert_ssse3(uint8_t *dest, const int *src, int count, RECOILPixelFormat format)
+{
+	int i = 0;
+	switch (format) {
+	case RECOIL_PIXEL_FORMAT_RGB24:
+	case RECOIL_PIXEL_FORMAT_BGR24:
+		{
+			const __m128i mask = format == RECOIL_PIXEL_FORMAT_RGB24
+				? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+				: _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+			for (; i + 16 <= count; i += 16) {
+				__m128i a = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (src + i)), mask);
+				__m128i b = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (src + i + 4)), mask);
+				__m128i c = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (src + i + 8)), mask);
+				__m128i d = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (src + i + 12)), mask);
+				_mm_storeu_si128((__m128i *) (dest + i * 3), _mm_or_si128(a, _mm_slli_si128(b, 12)));
+				_mm_storeu_si128((__m128i *) (dest + i * 3 + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+				_mm_storeu_si128((__m128i *) (dest + i * 3 + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+			}
+		}
+		break;
+	case RECOIL_PIXEL_FORMAT_RGBA32:
+	case RECOIL_PIXEL_FORMAT_BGRA32:
+		{
+			const __m128i mask = format == RECOIL_PIXEL_FORMAT_RGBA32
+				? _mm_setr_epi8(2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1)
+				: _mm_setr_epi8(0, 1, 2, -1, 4, 5, 6, -1, 8, 9, 10, -1, 12, 13, 14, -1);
+			const __m128i alpha = _mm_set1_epi32((int) 0xff000000);
+			for (; i + 4 <= count; i += 4) {
+				__m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *) (src + i)), mask);
+				_mm_storeu_si128((__m128i *) (dest + i * 4), _mm_or_si128(v, alpha));
+			}
+		}
+		break;
+	default:
+		break;
+	}
+	return i;
+}
+
+#endif
+
+#ifdef RECOIL_PIXELS_NEON
+
+static int convert_neon(uint8_t *dest, const int *src, int count, RECOILPixelFormat format)
+{
+	int i = 0;
+	switch (format) {
+	case RECOIL_PIXEL_FORMAT_RGB24:
+	case RECOIL_PIXEL_FORMAT_BGR24:
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x4_t bgrx = vld4q_u8((const uint8_t *) (src + i));
+			uint8x16x3_t out;
+			out.val[0] = format == RECOIL_PIXEL_FORMAT_RGB24 ? bgrx.val[2] : bgrx.val[0];
+			out.val[1] = bgrx.val[1];
+			out.val[2] = format == RECOIL_PIXEL_FORMAT_RGB24 ? bgrx.val[0] : bgrx.val[2];
+			vst3q_u8(dest + i * 3, out);
+		}
+		break;
+	case RECOIL_PIXEL_FORMAT_RGBA32:
+	case RECOIL_PIXEL_FORMAT_BGRA32:
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x4_t bgrx = vld4q_u8((const uint8_t *) (src + i));
+			if (format == RECOIL_PIXEL_FORMAT_RGBA32) {
+				uint8x16_t t = bgrx.val[0];
+				bgrx.val[0] = bgrx.val[2];
+				bgrx.val[2] = t;
+			}
+			bgrx.val[3] = vdupq_n_u8(0xff);
+			vst4q_u8(dest + i * 4, bgrx);
+		}
+		break;
+	default:
+		break;
+	}
+	return i;
+}
+
+#endif
+
+int RECOIL_GetPixelFormatSize(RECOILPixelFormat format)
+{
+	switch (format) {
+	case RECOIL_PIXEL_FORMAT_RGB24:
+	case RECOIL_PIXEL_FORMAT_BGR24:
+		return 3;
+	case RECOIL_PIXEL_FORMAT_RGBA32:
+	case RECOIL_PIXEL_FORMAT_BGRA32:
+		return 4;
+	case RECOIL_PIXEL_FORMAT_RGB565:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+void RECOIL_ConvertPixels(void *dest, const int *src, int count, RECOILPixelFormat format)
+{
+	uint8_t *d = (uint8_t *) dest;
+	int i = 0;
+#if defined(RECOIL_PIXELS_SSSE3)
+	if (__builtin_cpu_supports("ssse3"))
+		i = convert_ssse3(d, src, count, format);
+#elif defined(RECOIL_PIXELS_NEON)
+	i = convert_neon(d, src, count, format);
+#endif
+	switch (format) {
+	case RECOIL_PIXEL_FORMAT_RGB24:
+		for (; i < count; i++) {
+			int rgb = src[i];
+			d[i * 3] = (uint8_t) (rgb >> 16);
+			d[i * 3 + 1] = (uint8_t) (rgb >> 8);
+			d[i * 3 + 2] = (uint8_t) rgb;
+		}
+		break;
+	case RECOIL_PIXEL_FORMAT_BGR24:
+		for (; i < count; i++) {
+			int rgb = src[i];
+			d[i * 3] = (uint8_t) rgb;
+			d[i * 3 + 1] = (uint8_t) (rgb >> 8);
+			d[i * 3 + 2] = (uint8_t) (rgb >> 16);
+		}
+		break;
+	case RECOIL_PIXEL_FORMAT_RGBA32:
+		for (; i < count; i++) {
+			int rgb = src[i];
+			d[i * 4] = (uint8_t) (rgb >> 16);
+			d[i * 4 + 1] = (uint8_t) (rgb >> 8);
+			d[i * 4 + 2] = (uint8_t) rgb;
+			d[i * 4 + 3] = 0xff;
+		}
+		break;
+	case RECOIL_PIXEL_FORMAT_BGRA32:
+		for (; i < count; i++) {
+			int rgb = src[i];
+			d[i * 4] = (uint8_t) rgb;
+			d[i * 4 + 1] = (uint8_t) (rgb >> 8);
+			d[i * 4 + 2] = (uint8_t) (rgb >> 16);
+			d[i * 4 + 3] = 0xff;
+		}
+		break;
+	case RECOIL_PIXEL_FORMAT_RGB565:
+		for (; i < count; i++) {
+			int rgb = src[i];
+			uint16_t w = (uint16_t) ((rgb >> 8 & 0xf800) | (rgb >> 5 & 0x7e0) | (rgb >> 3 & 0x1f));
+			memcpy(d + i * 2, &w, 2);
+		}
+		break;
+	case RECOIL_PIXEL_FORMAT_GRAY8:
+		for (; i < count; i++) {
+			int rgb = src[i];
+			d[i] = (uint8_t) (((rgb >> 16 & 0xff) * 19595 + (rgb >> 8 & 0xff) * 38470 + (rgb & 0xff) * 7471 + 0x8000) >> 16);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+bool RECOIL_GetPixelsAs(RECOIL *recoil, void *dest, int stride, RECOILPixelFormat format)
+{
+	int width = RECOIL_GetWidth(recoil);
+	int height = RECOIL_GetHeight(recoil);
+	uint8_t *d = (uint8_t *) dest;
+	if (format == RECOIL_PIXEL_FORMAT_INDEXED8) {
+		if (RECOIL_ToPalette(recoil) == NULL)
+			return false;
+		const uint8_t *indexes = RECOIL_GetIndexes(recoil);
+		for (int y = 0; y < height; y++)
+			memcpy(d + y * stride, indexes + y * width, width);
+	}
+	else {
+		const int *pixels = RECOIL_GetPixels(recoil);
+		if (stride == width * RECOIL_GetPixelFormatSize(format))
+			RECOIL_ConvertPixels(d, pixels, width * height, format);
+		else {
+			for (int y = 0; y < height; y++)
+				RECOIL_ConvertPixels(d + y * stride, pixels + y * width, width, format);
+		}
+	}
+	return true;
+}
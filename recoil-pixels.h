@@ -0,0 +1,68 @@
+/*
+ * recoil-pixels.h - conversion of decoded pixels to common pixel formats
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _RECOILPIXELS_H_
+#define _RECOILPIXELS_H_
+
+#include <stdbool.h>
+
+#include "recoil.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	/* Three bytes per pixel: red, green, blue. */
+	RECOIL_PIXEL_FORMAT_RGB24,
+	/* Three bytes per pixel: blue, green, red (Windows DIB). */
+	RECOIL_PIXEL_FORMAT_BGR24,
+	/* Four bytes per pixel: red, green, blue, 255. */
+	RECOIL_PIXEL_FORMAT_RGBA32,
+	/* Four bytes per pixel: blue, green, red, 255. */
+	RECOIL_PIXEL_FORMAT_BGRA32,
+	/* 16-bit native-endian words: 5 bits red, 6 bits green, 5 bits blue. */
+	RECOIL_PIXEL_FORMAT_RGB565,
+	/* One byte of ITU-R BT.601 luma per pixel. */
+	RECOIL_PIXEL_FORMAT_GRAY8,
+	/* One byte per pixel indexing the palette returned by RECOIL_ToPalette. */
+	RECOIL_PIXEL_FORMAT_INDEXED8
+} RECOILPixelFormat;
+
+/* Returns the number of bytes per pixel in `format`. */
+int RECOIL_GetPixelFormatSize(RECOILPixelFormat format);
+
+/* Converts `count` 0xRRGGBB pixels to `format`, which must not be RECOIL_PIXEL_FORMAT_INDEXED8. */
+void RECOIL_ConvertPixels(void *dest, const int *src, int count, RECOILPixelFormat format);
+
+/* Writes the decoded picture to `dest`, `stride` bytes per row.
+   A negative `stride` writes bottom-up, with `dest` pointing to the top row.
+   Returns false if RECOIL_PIXEL_FORMAT_INDEXED8 was requested
+   and the picture has more than 256 colors. */
+bool RECOIL_GetPixelsAs(RECOIL *recoil, void *dest, int stride, RECOILPixelFormat format);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,443 @@
+/*
+ * recoil-scale.c - aspect-correct resampling of decoded pixels
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "recoil-scale.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define RECOIL_SCALE_SSE2
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define RECOIL_SCALE_NEON
+#include <arm_neon.h>
+#endif
+
+// don't start threads for fewer destination pixels per stripe
+#define MIN_STRIPE_PIXELS 65536
+
+// RECOIL_SCALE_AREA weights of every destination pixel sum up to this
+#define AREA_WEIGHT_TOTAL 256
+
+// Contributions of source pixels to destination pixels along one axis.
+// Every destination pixel takes `taps` consecutive source pixels starting at `first`.
+// Weights are at most 256, so that a weighted sum of 8-bit channels fits in 16 bits.
+typedef struct {
+	int taps;
+	int total;
+	int *first;
+	uint16_t *weights;
+} ScaleAxis;
+
+static bool init_axis(ScaleAxis *axis, int src_size, int dest_size, RECOILScaleFilter filter)
+{
+	int taps;
+	switch (filter) {
+	case RECOIL_SCALE_BOX:
+		if (dest_size >= src_size) {
+			if (dest_size % src_size != 0)
+				return false;
+			taps = 1;
+		}
+		else {
+			if (src_size % dest_size != 0 || src_size / dest_size > 256)
+				return false;
+			taps = src_size / dest_size;
+		}
+		axis->total = taps;
+		break;
+	case RECOIL_SCALE_AREA:
+		// a destination pixel covers [d * src_size, (d + 1) * src_size) in 1/dest_size units
+		taps = 1;
+		for (int d = 0; d < dest_size; d++) {
+			int n = (int) (((long long) (d + 1) * src_size - 1) / dest_size - (long long) d * src_size / dest_size + 1);
+			if (taps < n)
+				taps = n;
+		}
+		axis->total = AREA_WEIGHT_TOTAL;
+		break;
+	default:
+		return false;
+	}
+	axis->taps = taps;
+	axis->first = (int *) malloc(dest_size * sizeof(int));
+	axis->weights = (uint16_t *) calloc((size_t) dest_size * taps, sizeof(uint16_t));
+	if (axis->first == NULL || axis->weights == NULL)
+		return false;
+
+	for (int d = 0; d < dest_size; d++) {
+		uint16_t *weights = axis->weights + (size_t) d * taps;
+		if (filter == RECOIL_SCALE_BOX) {
+			if (dest_size >= src_size)
+				axis->first[d] = d / (dest_size / src_size);
+			else
+				axis->first[d] = d * taps;
+			for (int k = 0; k < taps; k++)
+				weights[k] = 1;
+		}
+		else {
+			long long start = (long long) d * src_size;
+			long long end = start + src_size;
+			int first = (int) (start / dest_size);
+			int last = (int) ((end - 1) / dest_size);
+			// keep all taps within the source row, the extra ones have zero weights
+			int base = first + taps <= src_size ? first : src_size - taps;
+			axis->first[d] = base;
+			// round cumulative sums, so that the weights add up exactly
+			long long covered = 0;
+			int previous = 0;
+			for (int s = first; s <= last; s++) {
+				long long left = (long long) s * dest_size;
+				long long right = left + dest_size;
+				covered += (right < end ? right : end) - (left > start ? left : start);
+				int cumulative = (int) ((covered * AREA_WEIGHT_TOTAL + (src_size >> 1)) / src_size);
+				weights[s - base] = (uint16_t) (cumulative - previous);
+				previous = cumulative;
+			}
+		}
+	}
+	return true;
+}
+
+static void free_axis(ScaleAxis *axis)
+{
+	free(axis->first);
+	free(axis->weights);
+}
+
+static bool is_same_tap(const ScaleAxis *axis, int d1, int d2)
+{
+	return axis->first[d1] == axis->first[d2]
+		&& memcmp(axis->weights + (size_t) d1 * axis->taps, axis->weights + (size_t) d2 * axis->taps, axis->taps * sizeof(uint16_t)) == 0;
+}
+
+#ifdef RECOIL_SCALE_SSE2
+
+/* Returns the number of accumulated channels, a multiple of 8. */
+__attribute__((target("sse2")))
+static int accumulate_sse2(uint32_t *acc, const uint16_t *row, int count, int weight)
+{
+	const __m128i w = _mm_set1_epi16((short) weight);
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m128i v = _mm_loadu_si128((const __m128i *) (row + i));
+		__m128i lo = _mm_mullo_epi16(v, w);
+		__m128i hi = _mm_mulhi_epu16(v, w);
+		__m128i *a = (__m128i *) (acc + i);
+		_mm_storeu_si128(a, _mm_add_epi32(_mm_loadu_si128(a), _mm_unpacklo_epi16(lo, hi)));
+		_mm_storeu_si128(a + 1, _mm_add_epi32(_mm_loadu_si128(a + 1), _mm_unpackhi_epi16(lo, hi)));
+	}
+	return i;
+}
+
+#endif
+
+#ifdef RECOIL_SCALE_NEON
+
+static int accumulate_neon(uint32_t *acc, const uint16_t *row, int count, int weight)
+{
+	int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		uint16x8_t v = vld1q_u16(row + i);
+		vst1q_u32(acc + i, vmlal_n_u16(vld1q_u32(acc + i), vget_low_u16(v), (uint16_t) weight));
+		vst1q_u32(acc + i + 4, vmlal_n_u16(vld1q_u32(acc + i + 4), vget_high_u16(v), (uint16_t) weight));
+	}
+	return i;
+}
+
+#endif
+
+/* Checks whether the SIMD accumulation can be used.
+   Called once per picture, not in the inner loop. */
+static bool has_simd(void)
+{
+#if defined(RECOIL_SCALE_SSE2) && defined(__SSE2__)
+	return true;
+#elif defined(RECOIL_SCALE_SSE2)
+	return __builtin_cpu_supports("sse2");
+#elif defined(RECOIL_SCALE_NEON)
+	return true;
+#else
+	return false;
+#endif
+}
+
+/* Adds `weight` times `row` to `acc`. */
+static void accumulate(uint32_t *acc, const uint16_t *row, int count, int weight, bool simd)
+{
+	int i = 0;
+	if (simd) {
+#if defined(RECOIL_SCALE_SSE2)
+		i = accumulate_sse2(acc, row, count, weight);
+#elif defined(RECOIL_SCALE_NEON)
+		i = accumulate_neon(acc, row, count, weight);
+#endif
+	}
+	for (; i < count; i++)
+		acc[i] += (uint32_t) row[i] * weight;
+}
+
+/* Resamples one source row horizontally into 16-bit red, green and blue sums. */
+static void scale_row(uint16_t *row, const int *src, const ScaleAxis *x, int width)
+{
+	int taps = x->taps;
+	const uint16_t *weights = x->weights;
+	for (int d = 0; d < width; d++, weights += taps) {
+		const int *p = src + x->first[d];
+		unsigned r = 0;
+		unsigned g = 0;
+		unsigned b = 0;
+		for (int k = 0; k < taps; k++) {
+			int rgb = p[k];
+			r += weights[k] * (rgb >> 16 & 0xff);
+			g += weights[k] * (rgb >> 8 & 0xff);
+			b += weights[k] * (rgb & 0xff);
+		}
+		row[d * 3] = (uint16_t) r;
+		row[d * 3 + 1] = (uint16_t) g;
+		row[d * 3 + 2] = (uint16_t) b;
+	}
+}
+
+typedef struct {
+	int *dest;
+	int dest_width;
+	int dest_height;
+	const int *src;
+	int src_width;
+	int src_height;
+	RECOILScaleFilter filter;
+	const ScaleAxis *x;
+	const ScaleAxis *y;
+	bool simd;
+	int first_row;
+	int end_row;
+	bool ok;
+} ScaleStripe;
+
+static void scale_nearest_stripe(ScaleStripe *stripe)
+{
+	int dest_width = stripe->dest_width;
+	int *columns = (int *) malloc(dest_width * sizeof(int));
+	if (columns == NULL)
+		return;
+	for (int d = 0; d < dest_width; d++)
+		columns[d] = (int) (((long long) d * 2 + 1) * stripe->src_width / (dest_width * 2LL));
+	int previous_y = -1;
+	for (int d = stripe->first_row; d < stripe->end_row; d++) {
+		int *dest = stripe->dest + (size_t) d * dest_width;
+		int y = (int) (((long long) d * 2 + 1) * stripe->src_height / (stripe->dest_height * 2LL));
+		if (y == previous_y)
+			memcpy(dest, dest - dest_width, dest_width * sizeof(int));
+		else {
+			const int *src = stripe->src + (size_t) y * stripe->src_width;
+			for (int x = 0; x < dest_width; x++)
+				dest[x] = src[columns[x]];
+			previous_y = y;
+		}
+	}
+	free(columns);
+	stripe->ok = true;
+}
+
+static void scale_stripe(ScaleStripe *stripe)
+{
+	if (stripe->filter == RECOIL_SCALE_NEAREST) {
+		scale_nearest_stripe(stripe);
+		return;
+	}
+	int dest_width = stripe->dest_width;
+	int channels = dest_width * 3;
+	uint16_t *row = (uint16_t *) malloc(channels * sizeof(uint16_t));
+	uint32_t *acc = (uint32_t *) malloc(channels * sizeof(uint32_t));
+	if (row != NULL && acc != NULL) {
+		const ScaleAxis *y = stripe->y;
+		uint32_t total = (uint32_t) stripe->x->total * y->total;
+		for (int d = stripe->first_row; d < stripe->end_row; d++) {
+			int *dest = stripe->dest + (size_t) d * dest_width;
+			if (d > stripe->first_row && is_same_tap(y, d, d - 1)) {
+				memcpy(dest, dest - dest_width, dest_width * sizeof(int));
+				continue;
+			}
+			memset(acc, 0, channels * sizeof(uint32_t));
+			const uint16_t *weights = y->weights + (size_t) d * y->taps;
+			for (int k = 0; k < y->taps; k++) {
+				if (weights[k] != 0) {
+					scale_row(row, stripe->src + (size_t) (y->first[d] + k) * stripe->src_width, stripe->x, dest_width);
+					accumulate(acc, row, channels, weights[k], stripe->simd);
+				}
+			}
+			uint32_t half = total >> 1;
+			for (int x = 0; x < dest_width; x++) {
+				dest[x] = (int) ((acc[x * 3] + half) / total << 16
+					| (acc[x * 3 + 1] + half) / total << 8
+					| (acc[x * 3 + 2] + half) / total);
+			}
+		}
+		stripe->ok = true;
+	}
+	free(row);
+	free(acc);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI scale_stripe_thread(LPVOID arg)
+{
+	scale_stripe((ScaleStripe *) arg);
+	return 0;
+}
+#else
+static void *scale_stripe_thread(void *arg)
+{
+	scale_stripe((ScaleStripe *) arg);
+	return NULL;
+}
+#endif
+
+static bool scale_parallel(ScaleStripe *stripes, int stripes_count)
+{
+	// the calling thread scales the last stripe
+#ifdef _WIN32
+	HANDLE *threads = (HANDLE *) calloc(stripes_count, sizeof(HANDLE));
+#else
+	pthread_t *threads = (pthread_t *) calloc(stripes_count, sizeof(pthread_t));
+	bool *started = (bool *) calloc(stripes_count, sizeof(bool));
+#endif
+	for (int i = 0; i < stripes_count - 1; i++) {
+#ifdef _WIN32
+		if (threads != NULL)
+			threads[i] = CreateThread(NULL, 0, scale_stripe_thread, stripes + i, 0, NULL);
+		if (threads == NULL || threads[i] == NULL)
+			scale_stripe(stripes + i);
+#else
+		if (threads != NULL && started != NULL)
+			started[i] = pthread_create(threads + i, NULL, scale_stripe_thread, stripes + i) == 0;
+		if (threads == NULL || started == NULL || !started[i])
+			scale_stripe(stripes + i);
+#endif
+	}
+	scale_stripe(stripes + stripes_count - 1);
+	for (int i = 0; i < stripes_count - 1; i++) {
+#ifdef _WIN32
+		if (threads != NULL && threads[i] != NULL) {
+			WaitForSingleObject(threads[i], INFINITE);
+			CloseHandle(threads[i]);
+		}
+#else
+		if (threads != NULL && started != NULL && started[i])
+			pthread_join(threads[i], NULL);
+#endif
+	}
+	free(threads);
+#ifndef _WIN32
+	free(started);
+#endif
+
+	bool ok = true;
+	for (int i = 0; i < stripes_count; i++)
+		ok &= stripes[i].ok;
+	return ok;
+}
+
+void RECOIL_GetAspectSize(const RECOIL *recoil, int *width, int *height)
+{
+	*width = RECOIL_GetWidth(recoil);
+	*height = RECOIL_GetHeight(recoil);
+	int x_ppm = RECOIL_GetXPixelsPerMeter(recoil);
+	int y_ppm = RECOIL_GetYPixelsPerMeter(recoil);
+	if (x_ppm <= 0 || y_ppm <= 0)
+		return;
+	// enlarge rather than lose pixels
+	if (x_ppm < y_ppm)
+		*width = (int) (((long long) *width * y_ppm + (x_ppm >> 1)) / x_ppm);
+	else
+		*height = (int) (((long long) *height * x_ppm + (y_ppm >> 1)) / y_ppm);
+}
+
+bool RECOIL_ScalePixels(int *dest, int dest_width, int dest_height, const int *src, int src_width, int src_height,
+	RECOILScaleFilter filter, int threads)
+{
+	if (dest_width <= 0 || dest_height <= 0 || src_width <= 0 || src_height <= 0)
+		return false;
+	if (dest_width == src_width && dest_height == src_height) {
+		memcpy(dest, src, (size_t) dest_width * dest_height * sizeof(int));
+		return true;
+	}
+
+	ScaleAxis x = { 0, 0, NULL, NULL };
+	ScaleAxis y = { 0, 0, NULL, NULL };
+	ScaleStripe *stripes = NULL;
+	bool ok = filter == RECOIL_SCALE_NEAREST
+		|| (init_axis(&x, src_width, dest_width, filter) && init_axis(&y, src_height, dest_height, filter));
+	if (ok) {
+		int stripes_count = (int) ((long long) dest_width * dest_height / MIN_STRIPE_PIXELS);
+		if (stripes_count > threads)
+			stripes_count = threads;
+		if (stripes_count > dest_height)
+			stripes_count = dest_height;
+		if (stripes_count < 1)
+			stripes_count = 1;
+		stripes = (ScaleStripe *) calloc(stripes_count, sizeof(ScaleStripe));
+		ok = stripes != NULL;
+		if (ok) {
+			bool simd = has_simd();
+			for (int i = 0; i < stripes_count; i++) {
+				ScaleStripe *stripe = stripes + i;
+				stripe->dest = dest;
+				stripe->dest_width = dest_width;
+				stripe->dest_height = dest_height;
+				stripe->src = src;
+				stripe->src_width = src_width;
+				stripe->src_height = src_height;
+				stripe->filter = filter;
+				stripe->x = &x;
+				stripe->y = &y;
+				stripe->simd = simd;
+				stripe->first_row = (int) ((long long) dest_height * i / stripes_count);
+				stripe->end_row = (int) ((long long) dest_height * (i + 1) / stripes_count);
+			}
+			if (stripes_count == 1) {
+				scale_stripe(stripes);
+				ok = stripes->ok;
+			}
+			else
+				ok = scale_parallel(stripes, stripes_count);
+		}
+	}
+	free(stripes);
+	free_axis(&x);
+	free_axis(&y);
+	return ok;
+}
+
+bool RECOIL_Scale(const RECOIL *recoil, int *dest, int width, int height, RECOILScaleFilter filter, int threads)
+{
+	return RECOIL_ScalePixels(dest, width, height, RECOIL_GetPixels(recoil), RECOIL_GetWidth(recoil), RECOIL_GetHeight(recoil), filter, threads);
+}
@@ -0,0 +1,65 @@
+/*
+ * recoil-scale.h - aspect-correct resampling of decoded pixels
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef _RECOILSCALE_H_
+#define _RECOILSCALE_H_
+
+#include <stdbool.h>
+
+#include "recoil.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+	/* Each destination pixel copies the source pixel under its center. */
+	RECOIL_SCALE_NEAREST,
+	/* Replicates or averages whole blocks of pixels.
+	   Each destination dimension must be a multiple or a divisor of the source one,
+	   with a factor of at most 256. */
+	RECOIL_SCALE_BOX,
+	/* Averages source pixels weighted by the area they cover in the destination pixel. */
+	RECOIL_SCALE_AREA
+} RECOILScaleFilter;
+
+/* Computes the size at which the decoded picture has the proportions it had on the original display.
+   One dimension of RECOIL_GetWidth x RECOIL_GetHeight is enlarged according to
+   RECOIL_GetXPixelsPerMeter and RECOIL_GetYPixelsPerMeter.
+   If the pixel density is unknown, returns the decoded size. */
+void RECOIL_GetAspectSize(const RECOIL *recoil, int *width, int *height);
+
+/* Resamples `src_width` x `src_height` 0xRRGGBB pixels to `dest_width` x `dest_height` 0xRRGGBB pixels.
+   `threads` greater than one processes horizontal stripes of the destination in parallel.
+   Returns false on invalid sizes, an unsupported RECOIL_SCALE_BOX ratio or out of memory. */
+bool RECOIL_ScalePixels(int *dest, int dest_width, int dest_height, const int *src, int src_width, int src_height,
+	RECOILScaleFilter filter, int threads);
+
+/* Resamples the decoded picture to `width` x `height` 0xRRGGBB pixels. */
+bool RECOIL_Scale(const RECOIL *recoil, int *dest, int width, int height, RECOILScaleFilter filter, int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
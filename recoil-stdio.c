@@ -23,11 +23,22 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#ifdef RECOIL_STATS
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#endif
 
 #include "recoil-stdio.h"
 
 typedef struct {
 	int (*readFile)(const RECOIL *self, const char *filename, uint8_t *content, int contentLength);
+	bool (*isCancelled)(const RECOIL *self);
+#ifdef RECOIL_STATS
+	int64_t (*getStatsTime)(const RECOIL *self);
+#endif
 } RECOILVtbl;
 
 static int RECOILStdio_ReadFile(const RECOIL *self, const char *filename, uint8_t *content, int contentLength)
@@ -40,11 +51,54 @@ static int RECOILStdio_ReadFile(const RECOIL *self, const char *filename, uint8_
 	return contentLength;
 }
 
+static _Thread_local bool (*cancel_callback)(void *context) = NULL;
+static _Thread_local void *cancel_context = NULL;
+
+void RECOILStdio_SetCancelCallback(bool (*is_cancelled)(void *context), void *context)
+{
+	cancel_callback = is_cancelled;
+	cancel_context = context;
+}
+
+void RECOILStdio_GetCancelCallback(bool (**is_cancelled)(void *context), void **context)
+{
+	*is_cancelled = cancel_callback;
+	*context = cancel_context;
+}
+
+static bool RECOILStdio_IsCancelled(const RECOIL *self)
+{
+	return cancel_callback != NULL && cancel_callback(cancel_context);
+}
+
+#ifdef RECOIL_STATS
+/* Returns monotonic time in nanoseconds. */
+static int64_t RECOILStdio_GetStatsTime(const RECOIL *self)
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter;
+	static LARGE_INTEGER frequency;
+	if (frequency.QuadPart == 0)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return counter.QuadPart / frequency.QuadPart * 1000000000 + counter.QuadPart % frequency.QuadPart * 1000000000 / frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * (int64_t) 1000000000 + ts.tv_nsec;
+#endif
+}
+#endif
+
 RECOIL *RECOILStdio_New(void)
 {
 	RECOIL *self = RECOIL_New();
 	if (self != NULL) {
-		static const RECOILVtbl vtbl = { RECOILStdio_ReadFile };
+#ifdef RECOIL_STATS
+		static const RECOILVtbl vtbl = { RECOILStdio_ReadFile, RECOILStdio_IsCancelled, RECOILStdio_GetStatsTime };
+#else
+		static const RECOILVtbl vtbl = { RECOILStdio_ReadFile, RECOILStdio_IsCancelled };
+#endif
 		*(const RECOILVtbl **) self = &vtbl;
 	}
 	return self;
@@ -24,6 +24,8 @@
 #ifndef _RECOILSTDIO_H_
 #define _RECOILSTDIO_H_
 
+#include <stdbool.h>
+
 #include "recoil.h"
 
 #ifdef __cplusplus
@@ -32,6 +34,16 @@ extern "C" {
 
 RECOIL *RECOILStdio_New(void);
 
+/* Makes RECOIL_Decode calls of RECOILStdio decoders on the calling thread
+   poll `is_cancelled(context)` and fail soon after it returns true,
+   with RECOIL_IsAborted returning true.
+   `is_cancelled` may check a flag set from another thread.
+   Pass NULL to stop polling. */
+void RECOILStdio_SetCancelCallback(bool (*is_cancelled)(void *context), void *context);
+
+/* Returns the callback set with RECOILStdio_SetCancelCallback on the calling thread. */
+void RECOILStdio_GetCancelCallback(bool (**is_cancelled)(void *context), void **context);
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,20 +24,69 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <zlib.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 #include "recoil-stdio.h"
+#include "recoil-container.h"
+#include "recoil-parallel.h"
+#include "recoil-scale.h"
 #include "pngsave.h"
+#include "imgsave.h"
+
+typedef bool (*SaveFunction)(RECOIL *recoil, FILE *fp);
+
+static RECOILPngOptions png_options;
+static bool print_stats = false;
+static bool probe_only = false;
+#define MAX_DECODE_THREADS 64
+static RECOIL *decode_workers[MAX_DECODE_THREADS - 1];
+static int decode_workers_count = 0;
+static int scale_filter = -1;
+
+static bool save_png(RECOIL *recoil, FILE *fp)
+{
+	return RECOIL_SavePngWithOptions(recoil, fp, &png_options);
+}
+
+static const struct OutputFormat {
+	const char *ext;
+	SaveFunction save;
+} output_formats[] = {
+	{ "png", save_png },
+	{ "pnm", RECOIL_SavePnm },
+	{ "ppm", RECOIL_SavePnm },
+	{ "pam", RECOIL_SavePam },
+	{ "bmp", RECOIL_SaveBmp },
+	{ "rgba", RECOIL_SaveRgba },
+	{ "qoi", RECOIL_SaveQoi }
+};
 
 static void print_help(void)
 {
 	printf(
 		"Usage: recoil2png [OPTIONS] INPUTFILE...\n"
 		"Options:\n"
-		"-o FILE  --output=FILE   Set output file name\n"
+		"-o FILE  --output=FILE   Set output file name (\"-\" for standard output)\n"
+		"-f FMT   --format=FMT    Set output format: png, pnm, pam, bmp, rgba or qoi\n"
+		"         --png-level=N   Set PNG compression level 0-9\n"
+		"         --png-filter=F  Set PNG row filter: none or adaptive\n"
+		"         --png-strategy=S  Set PNG deflate strategy: default, filtered, huffman, rle or fixed\n"
+		"         --png-threads=N Deflate PNG in N parallel stripes\n"
+		"         --decode-threads=N  Decode and scale large pictures in N parallel stripes\n"
+		"         --scale=F       Scale to the original proportions: nearest, box or area\n"
 		"         --pal           Emulate PAL video standard if applicable (default)\n"
 		"         --ntsc          Emulate NTSC video standard if applicable\n"
 		"-p FILE  --palette=FILE  Load Atari 8-bit or C64 palette\n"
+		"         --container     Convert all pictures in the following disk, tape or ZIP images\n"
+		"         --stats         Print decoder statistics to standard error\n"
+		"         --max-work=N    Give up decoding a file after N work units\n"
+		"         --probe         Print picture sizes and bytes needed to recognize them\n"
 		"-h       --help          Display this information\n"
 		"-v       --version       Display version information\n"
 	);
@@ -55,6 +104,24 @@ static int load_file(const char *filename, void *buffer, size_t buffer_len)
 	return len;
 }
 
+static const struct OutputFormat *find_format(const char *ext)
+{
+	for (const struct OutputFormat *pf = output_formats; pf < output_formats + sizeof(output_formats) / sizeof(output_formats[0]); pf++) {
+		int i;
+		for (i = 0; pf->ext[i] != '\0' && (ext[i] | 0x20) == pf->ext[i]; i++);
+		if (pf->ext[i] == '\0' && ext[i] == '\0')
+			return pf;
+	}
+	return NULL;
+}
+
+static const struct OutputFormat *find_filename_format(const char *filename)
+{
+	const char *dot = strrchr(filename, '.');
+	const struct OutputFormat *pf = dot == NULL ? NULL : find_format(dot + 1);
+	return pf == NULL ? output_formats : pf;
+}
+
 static bool load_palette(RECOIL *recoil, const char *filename)
 {
 	uint8_t content[RECOIL_MAX_PLATFORM_PALETTE_CONTENT_LENGTH];
@@ -70,37 +137,227 @@ static bool load_palette(RECOIL *recoil, const char *filename)
 	return true;
 }
 
-static bool process_file(RECOIL *recoil, const char *input_file, const char *output_file)
+static void show_stats(const RECOIL *recoil, const char *input_file)
 {
-	static uint8_t content[RECOIL_MAX_CONTENT_LENGTH];
-	int content_len = load_file(input_file, content, sizeof(content));
-	if (content_len < 0) {
-		/* error already printed */
-		return false;
-	}
-	if (!RECOIL_Decode(recoil, input_file, content, content_len)) {
-		fprintf(stderr, "recoil2png: %s: file decoding error\n", input_file);
-		return false;
+#ifdef RECOIL_STATS
+	static const char * const stage_names[] = { "header", "data", "done" };
+	const RECOILStats *stats = RECOIL_GetStats(recoil);
+	int decoders_count = RECOILStats_GetDecodersCount(stats);
+	fprintf(stderr, "%s: %d bytes, %s, %d decoder%s, %.3f ms\n", input_file, RECOILStats_GetContentLength(stats),
+		RECOILStats_GetResult(stats) ? "decoded" : "not decoded", decoders_count, decoders_count == 1 ? "" : "s",
+		RECOILStats_GetTime(stats) / 1e6);
+	for (int i = 0; i < decoders_count; i++) {
+		const RECOILDecoderStats *decoder = RECOILStats_GetDecoder(stats, i);
+		fprintf(stderr, "  %-24s %-6s %9d read %9d unpacked %10.3f ms\n", RECOILDecoderStats_GetName(decoder),
+			stage_names[RECOILDecoderStats_GetStage(decoder)], RECOILDecoderStats_GetBytesRead(decoder),
+			RECOILDecoderStats_GetBytesUnpacked(decoder), RECOILDecoderStats_GetTime(decoder) / 1e6);
 	}
+#endif
+}
 
+static bool save_file(RECOIL *recoil, const char *input_file, const char *output_file, const struct OutputFormat *format)
+{
 	if (output_file == NULL) {
 		static char output_default[FILENAME_MAX];
 		int i;
 		int dotp = 0;
-		for (i = 0; input_file[i] != '\0' && i < FILENAME_MAX - 5; i++)
+		if (format == NULL)
+			format = output_formats;
+		for (i = 0; input_file[i] != '\0' && i < FILENAME_MAX - 6; i++)
 			if ((output_default[i] = input_file[i]) == '.')
 				dotp = i;
-		strcpy(output_default + (dotp == 0 ? i : dotp), ".png");
+		output_default[dotp == 0 ? i : dotp] = '.';
+		strcpy(output_default + (dotp == 0 ? i : dotp) + 1, format->ext);
 		output_file = output_default;
 	}
-	FILE *fp = fopen(output_file, "wb");
-	if (fp == NULL || !RECOIL_SavePng(recoil, fp)) {
+	FILE *fp;
+	if (strcmp(output_file, "-") == 0) {
+#ifdef _WIN32
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		fp = stdout;
+		if (format == NULL)
+			format = output_formats;
+	}
+	else {
+		fp = fopen(output_file, "wb");
+		if (format == NULL)
+			format = find_filename_format(output_file);
+	}
+	if (fp == NULL || !format->save(recoil, fp)) {
 		fprintf(stderr, "recoil2png: cannot write %s\n", output_file);
 		return false;
 	}
 	return true;
 }
 
+static bool scale_picture(RECOIL *recoil, const char *input_file)
+{
+	if (scale_filter < 0)
+		return true;
+	int src_width = RECOIL_GetWidth(recoil);
+	int src_height = RECOIL_GetHeight(recoil);
+	int width;
+	int height;
+	RECOIL_GetAspectSize(recoil, &width, &height);
+	if (scale_filter == RECOIL_SCALE_BOX) {
+		// round to whole multiples
+		width = (width + (src_width >> 1)) / src_width * src_width;
+		height = (height + (src_height >> 1)) / src_height * src_height;
+	}
+	if (width == src_width && height == src_height)
+		return true;
+	int *pixels = (int *) malloc((size_t) width * height * sizeof(int));
+	bool ok = pixels != NULL
+		&& RECOIL_Scale(recoil, pixels, width, height, (RECOILScaleFilter) scale_filter, decode_workers_count + 1)
+		&& RECOIL_SetResampledPixels(recoil, pixels, width, height);
+	free(pixels);
+	if (!ok)
+		fprintf(stderr, "recoil2png: %s: cannot scale to %dx%d\n", input_file, width, height);
+	return ok;
+}
+
+static bool probe_file(RECOIL *recoil, const char *input_file, const uint8_t *content, int content_len)
+{
+	int probe_len = RECOIL_GetProbeLength(recoil, input_file, content, content_len);
+	if (RECOIL_Probe(recoil, input_file, content, probe_len, content_len) != RECOILProbeResult_ACCEPTED) {
+		fprintf(stderr, "recoil2png: %s: file decoding error\n", input_file);
+		return false;
+	}
+	printf("%s: %dx%d, recognized after %d of %d bytes\n", input_file, RECOIL_GetWidth(recoil), RECOIL_GetHeight(recoil), probe_len, content_len);
+	return true;
+}
+
+static bool process_file(RECOIL *recoil, const char *input_file, const char *output_file, const struct OutputFormat *format)
+{
+	static uint8_t content[RECOIL_MAX_CONTENT_LENGTH];
+	int content_len = load_file(input_file, content, sizeof(content));
+	if (content_len < 0) {
+		/* error already printed */
+		return false;
+	}
+	if (probe_only)
+		return probe_file(recoil, input_file, content, content_len);
+	bool decoded = RECOIL_DecodeParallel(recoil, input_file, content, content_len, decode_workers, decode_workers_count, RECOIL_PARALLEL_MIN_PIXELS);
+	if (print_stats)
+		show_stats(recoil, input_file);
+	if (!decoded) {
+		fprintf(stderr, "recoil2png: %s: %s\n", input_file, RECOIL_IsAborted(recoil) ? "work budget exceeded" : "file decoding error");
+		return false;
+	}
+	return scale_picture(recoil, input_file) && save_file(recoil, input_file, output_file, format);
+}
+
+static bool process_container(RECOIL *recoil, const char *input_file, const struct OutputFormat *format)
+{
+	FILE *fp = fopen(input_file, "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "recoil2png: cannot open %s\n", input_file);
+		return false;
+	}
+	// containers may be larger than RECOIL_MAX_CONTENT_LENGTH
+	long content_len = fseek(fp, 0, SEEK_END) == 0 ? ftell(fp) : -1;
+	uint8_t *content = content_len < 0 || content_len > INT32_MAX || fseek(fp, 0, SEEK_SET) != 0 ? NULL : (uint8_t *) malloc(content_len + 1);
+	if (content == NULL || fread(content, 1, content_len, fp) != content_len) {
+		fclose(fp);
+		free(content);
+		fprintf(stderr, "recoil2png: cannot read %s\n", input_file);
+		return false;
+	}
+	fclose(fp);
+
+	RECOILContainer container;
+	if (!RECOIL_OpenContainer(&container, input_file, content, (int) content_len)) {
+		free(content);
+		fprintf(stderr, "recoil2png: %s: unsupported container\n", input_file);
+		return false;
+	}
+	if (format == NULL)
+		format = output_formats;
+	const char *dot = strrchr(input_file, '.');
+	int prefix_len = dot == NULL ? (int) strlen(input_file) : (int) (dot - input_file);
+	static uint8_t buffer[RECOIL_MAX_CONTENT_LENGTH];
+	bool ok = true;
+	while (RECOIL_NextContainerEntry(&container)) {
+		if (!RECOIL_IsOurFile(container.name))
+			continue;
+		if (!RECOIL_DecodeContainerEntry(recoil, &container, buffer)) {
+			fprintf(stderr, "recoil2png: %s: %s: file decoding error\n", input_file, container.name);
+			ok = false;
+			continue;
+		}
+		char output_file[FILENAME_MAX];
+		if (snprintf(output_file, sizeof(output_file), "%.*s-%s.%s", prefix_len, input_file, container.name, format->ext) >= (int) sizeof(output_file)) {
+			fprintf(stderr, "recoil2png: %s: %s: output file name too long\n", input_file, container.name);
+			ok = false;
+			continue;
+		}
+		for (char *p = output_file + prefix_len; *p != '\0'; p++) {
+			if (*p == '/')
+				*p = '_';
+		}
+		ok &= scale_picture(recoil, container.name) && save_file(recoil, container.name, output_file, format);
+	}
+	free(content);
+	return ok;
+}
+
+static bool set_png_strategy(const char *s)
+{
+	static const char * const names[] = { "default", "filtered", "huffman", "rle", "fixed" };
+	static const int strategies[] = { Z_DEFAULT_STRATEGY, Z_FILTERED, Z_HUFFMAN_ONLY, Z_RLE, Z_FIXED };
+	for (int i = 0; i < 5; i++) {
+		if (strcmp(s, names[i]) == 0) {
+			png_options.strategy = strategies[i];
+			return true;
+		}
+	}
+	fprintf(stderr, "recoil2png: unknown PNG strategy: %s\n", s);
+	return false;
+}
+
+static bool set_decode_threads(int threads)
+{
+	if (threads > MAX_DECODE_THREADS) {
+		fprintf(stderr, "recoil2png: at most %d decode threads supported\n", MAX_DECODE_THREADS);
+		return false;
+	}
+	for (; decode_workers_count < threads - 1; decode_workers_count++) {
+		decode_workers[decode_workers_count] = RECOILStdio_New();
+		if (decode_workers[decode_workers_count] == NULL) {
+			fprintf(stderr, "recoil2png: out of memory\n");
+			return false;
+		}
+	}
+	while (decode_workers_count > threads - 1)
+		RECOIL_Delete(decode_workers[--decode_workers_count]);
+	return true;
+}
+
+static bool set_scale_filter(const char *s)
+{
+	static const char * const names[] = { "nearest", "box", "area" };
+	static const RECOILScaleFilter filters[] = { RECOIL_SCALE_NEAREST, RECOIL_SCALE_BOX, RECOIL_SCALE_AREA };
+	for (int i = 0; i < 3; i++) {
+		if (strcmp(s, names[i]) == 0) {
+			scale_filter = filters[i];
+			return true;
+		}
+	}
+	fprintf(stderr, "recoil2png: unknown scale filter: %s\n", s);
+	return false;
+}
+
+static bool set_format(const struct OutputFormat **format, const char *ext)
+{
+	*format = find_format(ext);
+	if (*format == NULL) {
+		fprintf(stderr, "recoil2png: unknown output format: %s\n", ext);
+		return false;
+	}
+	return true;
+}
+
 int main(int argc, char **argv)
 {
 	RECOIL *recoil = RECOILStdio_New();
@@ -108,13 +365,23 @@ int main(int argc, char **argv)
 		fprintf(stderr, "recoil2png: out of memory\n");
 		return 1;
 	}
+	RECOIL_InitPngOptions(&png_options);
 	const char *output_file = NULL;
+	const struct OutputFormat *format = NULL;
 	bool ok = true;
 	bool no_input_files = true;
+	bool containers = false;
 	for (int i = 1; i < argc; i++) {
 		const char *arg = argv[i];
 		if (arg[0] != '-') {
-			ok &= process_file(recoil, arg, output_file);
+			if (!containers)
+				ok &= process_file(recoil, arg, output_file, format);
+			else if (output_file != NULL) {
+				fprintf(stderr, "recoil2png: cannot use --output with --container\n");
+				return 1;
+			}
+			else
+				ok &= process_container(recoil, arg, format);
 			no_input_files = false;
 			output_file = NULL;
 		}
@@ -122,6 +389,34 @@ int main(int argc, char **argv)
 			output_file = argv[++i];
 		else if (strncmp(arg, "--output=", 9) == 0)
 			output_file = arg + 9;
+		else if (arg[1] == 'f' && arg[2] == '\0' && i + 1 < argc) {
+			if (!set_format(&format, argv[++i]))
+				return 1;
+		}
+		else if (strncmp(arg, "--format=", 9) == 0) {
+			if (!set_format(&format, arg + 9))
+				return 1;
+		}
+		else if (strncmp(arg, "--png-level=", 12) == 0 && arg[12] >= '0' && arg[12] <= '9' && arg[13] == '\0')
+			png_options.level = arg[12] - '0';
+		else if (strcmp(arg, "--png-filter=none") == 0)
+			png_options.filter = RECOIL_PNG_FILTER_NONE;
+		else if (strcmp(arg, "--png-filter=adaptive") == 0)
+			png_options.filter = RECOIL_PNG_FILTER_ADAPTIVE;
+		else if (strncmp(arg, "--png-strategy=", 15) == 0) {
+			if (!set_png_strategy(arg + 15))
+				return 1;
+		}
+		else if (strncmp(arg, "--png-threads=", 14) == 0 && atoi(arg + 14) > 0)
+			png_options.threads = atoi(arg + 14);
+		else if (strncmp(arg, "--decode-threads=", 17) == 0 && atoi(arg + 17) > 0) {
+			if (!set_decode_threads(atoi(arg + 17)))
+				return 1;
+		}
+		else if (strncmp(arg, "--scale=", 8) == 0) {
+			if (!set_scale_filter(arg + 8))
+				return 1;
+		}
 		else if (strcmp(arg, "--pal") == 0)
 			RECOIL_SetNtsc(recoil, false);
 		else if (strcmp(arg, "--ntsc") == 0)
@@ -134,6 +429,20 @@ int main(int argc, char **argv)
 			if (!load_palette(recoil, arg + 10))
 				return 1;
 		}
+		else if (strcmp(arg, "--container") == 0)
+			containers = true;
+		else if (strncmp(arg, "--max-work=", 11) == 0 && atoi(arg + 11) > 0)
+			RECOIL_SetWorkBudget(recoil, atoi(arg + 11));
+		else if (strcmp(arg, "--probe") == 0)
+			probe_only = true;
+		else if (strcmp(arg, "--stats") == 0) {
+#ifdef RECOIL_STATS
+			print_stats = true;
+#else
+			fprintf(stderr, "recoil2png: --stats not available, rebuild with \"make STATS=1\"\n");
+			return 1;
+#endif
+		}
 		else if ((arg[1] == 'h' && arg[2] == '\0')
 			|| strcmp(arg, "--help") == 0) {
 			print_help();
@@ -0,0 +1,502 @@
+/*
+ * streambench.c - benchmark RECOIL decompression streams
+ *
+ * Copyright (C) 2021  Piotr Fusik
+ *
+ * This file is part of RECOIL (Retro Computer Image Library),
+ * see http://recoil.sourceforge.net
+ *
+ * RECOIL is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * RECOIL is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty
+ * of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with RECOIL; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <zlib.h>
+
+/* recoil.ci translated with -D RECOIL_STREAM_BENCHMARK */
+#include "recoil-streambench.h"
+
+/* Length of synthetic data, one Atari ST screen. */
+#define SYNTHETIC_LENGTH 32000
+/* Maximum length of unpacked real payloads. */
+#define MAX_UNPACKED_LENGTH (16 << 20)
+
+typedef struct {
+	const char *name;
+	RECOILStreamEngine engine;
+	/* Compresses SYNTHETIC_LENGTH bytes. Returns the compressed length. NULL if not available. */
+	int (*pack)(uint8_t *dest, const uint8_t *src);
+	/* Values of the synthetic bytes, for encoders that cannot represent all 256. */
+	int values;
+} Engine;
+
+static int repeat = 100;
+static int warmup = 1;
+static int run_length = 4;
+static int unpacked_len = MAX_UNPACKED_LENGTH;
+static uint32_t seed = 1;
+
+static void print_help(void)
+{
+	printf(
+		"Usage: streambench [OPTIONS] [ENGINE:FILE...]\n"
+		"Without files, runs all engines on synthetic data.\n"
+		"Engines: packbits, koala, ca, img, inflate, ice, lz4, pic, fano\n"
+		"Options:\n"
+		"-n N     --repeat=N      Time N runs of each payload (default 100)\n"
+		"-w N     --warmup=N      Discard N initial runs (default 1)\n"
+		"         --run=N         Repeat synthetic bytes N times on average (default 4)\n"
+		"         --seed=N        Set random seed (default 1)\n"
+		"         --unpacked=N    Unpack N bytes of files (default 16 MB, LZ4 content size)\n"
+		"-h       --help          Display this information\n"
+	);
+}
+
+static int64_t get_time_ns(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER counter;
+	LARGE_INTEGER frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+	return counter.QuadPart / frequency.QuadPart * 1000000000
+		+ counter.QuadPart % frequency.QuadPart * 1000000000 / frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static int compare_samples(const void *p1, const void *p2)
+{
+	int64_t a = *(const int64_t *) p1;
+	int64_t b = *(const int64_t *) p2;
+	return a < b ? -1 : a > b;
+}
+
+static uint32_t next_random(uint32_t *state)
+{
+	// xorshift32
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+/* Fills `data` with runs of random values smaller than `values`. */
+static void fill(uint8_t *data, int values)
+{
+	uint32_t state = seed == 0 ? 1 : seed;
+	for (int i = 0; i < SYNTHETIC_LENGTH; ) {
+		uint32_t r = next_random(&state);
+		int n = run_length <= 1 ? 1 : 1 + (int) (r >> 8) % (run_length * 2 - 1);
+		if (n > SYNTHETIC_LENGTH - i)
+			n = SYNTHETIC_LENGTH - i;
+		memset(data + i, (r & 0xff) % values, n);
+		i += n;
+	}
+}
+
+static int get_run(const uint8_t *src, int i, int max)
+{
+	int run;
+	for (run = 1; i + run < SYNTHETIC_LENGTH && run < max && src[i + run] == src[i]; run++);
+	return run;
+}
+
+static int pack_bits(uint8_t *dest, const uint8_t *src)
+{
+	int d = 0;
+	for (int i = 0; i < SYNTHETIC_LENGTH; ) {
+		int run = get_run(src, i, 128);
+		if (run >= 3) {
+			dest[d++] = (uint8_t) (257 - run);
+			dest[d++] = src[i];
+			i += run;
+			continue;
+		}
+		int literal;
+		for (literal = 1; i + literal < SYNTHETIC_LENGTH && literal < 128 && get_run(src, i + literal, 3) < 3; literal++);
+		dest[d++] = (uint8_t) (literal - 1);
+		memcpy(dest + d, src + i, literal);
+		d += literal;
+		i += literal;
+	}
+	return d;
+}
+
+static int pack_koala(uint8_t *dest, const uint8_t *src)
+{
+	int d = 0;
+	for (int i = 0; i < SYNTHETIC_LENGTH; ) {
+		int run = get_run(src, i, 255);
+		if (run >= 4 || src[i] == 0xfe) {
+			dest[d++] = 0xfe;
+			dest[d++] = src[i];
+			dest[d++] = (uint8_t) run;
+			i += run;
+		}
+		else
+			dest[d++] = src[i++];
+	}
+	return d;
+}
+
+static int pack_ca(uint8_t *dest, const uint8_t *src)
+{
+	enum { ESCAPE = 0xe5 };
+	dest[0] = ESCAPE;
+	dest[1] = 0; // default value
+	dest[2] = 0;
+	dest[3] = 1; // column step
+	int d = 4;
+	for (int i = 0; i < SYNTHETIC_LENGTH; ) {
+		int run = get_run(src, i, 256);
+		if (run >= 4) {
+			dest[d++] = ESCAPE;
+			dest[d++] = 0;
+			dest[d++] = (uint8_t) (run - 1);
+			dest[d++] = src[i];
+			i += run;
+		}
+		else {
+			if (src[i] == ESCAPE)
+				dest[d++] = ESCAPE;
+			dest[d++] = src[i++];
+		}
+	}
+	return d;
+}
+
+static int pack_img(uint8_t *dest, const uint8_t *src)
+{
+	memset(dest, 0, 16);
+	dest[3] = 8; // header length in words
+	dest[7] = 1; // pattern length
+	int d = 16;
+	for (int i = 0; i < SYNTHETIC_LENGTH; ) {
+		int run = get_run(src, i, 127);
+		if (src[i] == 0 || src[i] == 0xff) {
+			// solid run
+			dest[d++] = (uint8_t) ((src[i] & 0x80) | run);
+			i += run;
+			continue;
+		}
+		int literal;
+		for (literal = 1; i + literal < SYNTHETIC_LENGTH && literal < 255 && src[i + literal] != 0 && src[i + literal] != 0xff; literal++);
+		dest[d++] = 0x80;
+		dest[d++] = (uint8_t) literal;
+		memcpy(dest + d, src + i, literal);
+		d += literal;
+		i += literal;
+	}
+	return d;
+}
+
+static int pack_inflate(uint8_t *dest, const uint8_t *src)
+{
+	uLongf dest_len = compressBound(SYNTHETIC_LENGTH);
+	return compress2(dest, &dest_len, src, SYNTHETIC_LENGTH, Z_BEST_COMPRESSION) == Z_OK ? (int) dest_len : 0;
+}
+
+static int put_lz4_count(uint8_t *dest, int count)
+{
+	int d = 0;
+	for (count -= 15; count >= 255; count -= 255)
+		dest[d++] = 255;
+	dest[d++] = (uint8_t) count;
+	return d;
+}
+
+/* Compresses runs as matches at distance 1 and everything else as literals. */
+static int pack_lz4(uint8_t *dest, const uint8_t *src)
+{
+	static const uint8_t header[] = { 0x04, 0x22, 0x4d, 0x18, 0x40, 0x40, 0x00 };
+	memcpy(dest, header, sizeof(header));
+	int d = sizeof(header) + 4;
+	int literal_start = 0;
+	for (int i = 0; ; ) {
+		int run = i < SYNTHETIC_LENGTH ? get_run(src, i, SYNTHETIC_LENGTH) : 0;
+		if (run < 5 && i < SYNTHETIC_LENGTH) {
+			i += run;
+			continue;
+		}
+		// literals up to and including the first byte of the run
+		int literal_end = i < SYNTHETIC_LENGTH ? i + 1 : i;
+		int literals = literal_end - literal_start;
+		int match = run - 1;
+		uint8_t *token = dest + d++;
+		*token = (uint8_t) ((literals < 15 ? literals : 15) << 4);
+		if (literals >= 15)
+			d += put_lz4_count(dest + d, literals);
+		memcpy(dest + d, src + literal_start, literals);
+		d += literals;
+		if (i >= SYNTHETIC_LENGTH)
+			break;
+		dest[d++] = 1; // distance
+		dest[d++] = 0;
+		*token |= match - 4 < 15 ? match - 4 : 15;
+		if (match - 4 >= 15)
+			d += put_lz4_count(dest + d, match - 4);
+		i += run;
+		literal_start = i;
+	}
+	int block_size = d - sizeof(header) - 4;
+	for (int i = 0; i < 4; i++) {
+		dest[sizeof(header) + i] = (uint8_t) (block_size >> (i * 8));
+		dest[d++] = 0; // end mark
+	}
+	return d;
+}
+
+/* Random bits are valid run length codes. */
+static int pack_pic(uint8_t *dest, const uint8_t *src)
+{
+	uint32_t state = seed == 0 ? 1 : seed;
+	for (int i = 0; i < SYNTHETIC_LENGTH; i++)
+		dest[i] = (uint8_t) next_random(&state);
+	return SYNTHETIC_LENGTH;
+}
+
+/* Values 0-127 have 8-bit codes 128-255, values 128-191 have 7-bit codes 0-63. */
+static int pack_fano(uint8_t *dest, const uint8_t *src)
+{
+	memset(dest, 0x88, 64);
+	memset(dest + 64, 0x77, 32);
+	memset(dest + 96, 0, 32);
+	int d = 128;
+	int bits = 1;
+	for (int i = 0; i < SYNTHETIC_LENGTH; i++) {
+		int code = src[i] < 128 ? 0x80 | src[i] : src[i] - 128;
+		for (int shift = src[i] < 128 ? 7 : 6; shift >= 0; shift--) {
+			bits = bits << 1 | (code >> shift & 1);
+			if (bits >= 0x100) {
+				dest[d++] = (uint8_t) bits;
+				bits = 1;
+			}
+		}
+	}
+	if (bits > 1) {
+		while (bits < 0x100)
+			bits <<= 1;
+		dest[d++] = (uint8_t) bits;
+	}
+	return d;
+}
+
+static const Engine engines[] = {
+	{ "packbits", RECOILStreamEngine_PACK_BITS, pack_bits, 256 },
+	{ "koala", RECOILStreamEngine_KOALA, pack_koala, 256 },
+	{ "ca", RECOILStreamEngine_CA, pack_ca, 256 },
+	{ "img", RECOILStreamEngine_IMG, pack_img, 256 },
+	{ "inflate", RECOILStreamEngine_INFLATE, pack_inflate, 256 },
+	{ "ice", RECOILStreamEngine_ICE, NULL, 256 },
+	{ "lz4", RECOILStreamEngine_LZ4, pack_lz4, 256 },
+	{ "pic", RECOILStreamEngine_PIC, pack_pic, 256 },
+	{ "fano", RECOILStreamEngine_FANO, pack_fano, 192 }
+};
+
+#define ENGINES_COUNT (int) (sizeof(engines) / sizeof(engines[0]))
+
+static const Engine *find_engine(const char *name, size_t name_len)
+{
+	for (int i = 0; i < ENGINES_COUNT; i++) {
+		if (strlen(engines[i].name) == name_len && memcmp(engines[i].name, name, name_len) == 0)
+			return engines + i;
+	}
+	return NULL;
+}
+
+/* Times `engine` on `content`. Returns false on error. */
+static bool run_payload(RECOILStreamBenchmark *bench, const Engine *engine, const char *source, const uint8_t *content, int content_len,
+	uint8_t *unpacked, int unpacked_len, const uint8_t *expected, int64_t *samples)
+{
+	int result = -1;
+	for (int i = -warmup; i < repeat; i++) {
+		int64_t start = get_time_ns();
+		result = RECOILStreamBenchmark_Run(bench, engine->engine, content, content_len, unpacked, unpacked_len);
+		int64_t ns = get_time_ns() - start;
+		if (result < 0) {
+			fprintf(stderr, "streambench: %s: %s: decompression failed\n", engine->name, source);
+			return false;
+		}
+		if (i >= 0)
+			samples[i] = ns;
+	}
+	if (expected != NULL && (result != unpacked_len || memcmp(unpacked, expected, unpacked_len) != 0)) {
+		fprintf(stderr, "streambench: %s: %s: unpacked data differs\n", engine->name, source);
+		return false;
+	}
+	qsort(samples, repeat, sizeof(samples[0]), compare_samples);
+	int64_t median = samples[repeat >> 1];
+	int symbols = RECOILStreamBenchmark_GetSymbols(bench);
+	printf("%-9s %-20s %9d %9d %9d %12.3f %9.2f %9.2f\n", engine->name, source, content_len, result, symbols, median * 1e-3,
+		result > 0 ? (double) median / result : 0.0, symbols > 0 ? (double) median / symbols : 0.0);
+	return true;
+}
+
+static uint8_t *load_file(const char *filename, int *content_len)
+{
+	FILE *fp = fopen(filename, "rb");
+	if (fp == NULL)
+		return NULL;
+	uint8_t *content = NULL;
+	if (fseek(fp, 0, SEEK_END) == 0) {
+		long len = ftell(fp);
+		if (len > 0 && len <= MAX_UNPACKED_LENGTH && fseek(fp, 0, SEEK_SET) == 0) {
+			content = (uint8_t *) malloc(len);
+			if (content != NULL && fread(content, 1, len, fp) != len) {
+				free(content);
+				content = NULL;
+			}
+			*content_len = (int) len;
+		}
+	}
+	fclose(fp);
+	return content;
+}
+
+static bool parse_count(int *result, const char *s, int min, int max)
+{
+	char *end;
+	long n = strtol(s, &end, 10);
+	if (*s == '\0' || *end != '\0' || n < min || n > max) {
+		fprintf(stderr, "streambench: invalid number: %s\n", s);
+		return false;
+	}
+	*result = (int) n;
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	int payloads = 0;
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		int n;
+		if (arg[0] != '-')
+			payloads++;
+		else if (arg[1] == 'n' && arg[2] == '\0' && i + 1 < argc) {
+			if (!parse_count(&repeat, argv[++i], 1, 1000000))
+				return 1;
+		}
+		else if (strncmp(arg, "--repeat=", 9) == 0) {
+			if (!parse_count(&repeat, arg + 9, 1, 1000000))
+				return 1;
+		}
+		else if (arg[1] == 'w' && arg[2] == '\0' && i + 1 < argc) {
+			if (!parse_count(&warmup, argv[++i], 0, 1000000))
+				return 1;
+		}
+		else if (strncmp(arg, "--warmup=", 9) == 0) {
+			if (!parse_count(&warmup, arg + 9, 0, 1000000))
+				return 1;
+		}
+		else if (strncmp(arg, "--run=", 6) == 0) {
+			if (!parse_count(&run_length, arg + 6, 1, 65536))
+				return 1;
+		}
+		else if (strncmp(arg, "--seed=", 7) == 0) {
+			if (!parse_count(&n, arg + 7, 0, 0x7fffffff))
+				return 1;
+			seed = n;
+		}
+		else if (strncmp(arg, "--unpacked=", 11) == 0) {
+			if (!parse_count(&unpacked_len, arg + 11, 1, MAX_UNPACKED_LENGTH))
+				return 1;
+		}
+		else if ((arg[1] == 'h' && arg[2] == '\0')
+			|| strcmp(arg, "--help") == 0) {
+			print_help();
+			return 0;
+		}
+		else {
+			fprintf(stderr, "streambench: unknown option: %s\n", arg);
+			return 1;
+		}
+	}
+
+	RECOILStreamBenchmark *bench = RECOILStreamBenchmark_New();
+	uint8_t *unpacked = (uint8_t *) malloc(MAX_UNPACKED_LENGTH);
+	int64_t *samples = (int64_t *) malloc(repeat * sizeof(int64_t));
+	if (bench == NULL || unpacked == NULL || samples == NULL) {
+		fprintf(stderr, "streambench: out of memory\n");
+		return 1;
+	}
+	printf("Engine    Source                  Packed  Unpacked   Symbols    Median us   ns/byte ns/symbol\n");
+	bool ok = true;
+	if (payloads == 0) {
+		static uint8_t src[SYNTHETIC_LENGTH];
+		// room for incompressible data with command overhead
+		static uint8_t content[SYNTHETIC_LENGTH * 2];
+		for (int i = 0; i < ENGINES_COUNT; i++) {
+			const Engine *engine = engines + i;
+			if (engine->pack == NULL)
+				continue;
+			fill(src, engine->values);
+			int content_len = engine->pack(content, src);
+			// run lengths are not compared with the source
+			const uint8_t *expected = engine->engine == RECOILStreamEngine_PIC ? NULL : src;
+			if (content_len == 0
+			 || !run_payload(bench, engine, "synthetic", content, content_len, unpacked, SYNTHETIC_LENGTH, expected, samples))
+				ok = false;
+		}
+	}
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		if (arg[0] == '-') {
+			if ((arg[1] == 'n' || arg[1] == 'w') && arg[2] == '\0')
+				i++;
+			continue;
+		}
+		const char *colon = strchr(arg, ':');
+		const Engine *engine = colon == NULL ? NULL : find_engine(arg, colon - arg);
+		if (engine == NULL) {
+			fprintf(stderr, "streambench: %s: expected ENGINE:FILE\n", arg);
+			ok = false;
+			continue;
+		}
+		const char *filename = colon + 1;
+		int content_len;
+		uint8_t *content = load_file(filename, &content_len);
+		if (content == NULL) {
+			fprintf(stderr, "streambench: cannot read %s\n", filename);
+			ok = false;
+			continue;
+		}
+		// LZ4 frames must unpack to the exact length, take it from the frame if stored
+		int len = unpacked_len;
+		if (engine->engine == RECOILStreamEngine_LZ4 && content_len >= 14 && (content[4] & 0x08) != 0
+		 && content[10] == 0 && content[11] == 0 && content[12] == 0 && content[13] == 0
+		 && content[6] + (content[7] << 8) + (content[8] << 16) + ((int64_t) content[9] << 24) <= MAX_UNPACKED_LENGTH)
+			len = content[6] | content[7] << 8 | content[8] << 16 | content[9] << 24;
+		if (!run_payload(bench, engine, filename, content, content_len, unpacked, len, NULL, samples))
+			ok = false;
+		free(content);
+	}
+	free(samples);
+	free(unpacked);
+	RECOILStreamBenchmark_Delete(bench);
+	return ok ? 0 : 1;
+}
@@ -25,6 +25,7 @@
 
 #include "ImagPlug.h"
 #include "recoil-win32.h"
+#include "recoil-pixels.h"
 #include "formats.h"
 
 #define VERSION_NUMBER ((RECOIL_VERSION_MAJOR<<24)|(RECOIL_VERSION_MINOR<<16)|(RECOIL_VERSION_MICRO<<8))
@@ -75,14 +76,7 @@ static LPIMAGINEBITMAP IMAGINEAPI loadFile(IMAGINEPLUGINFILEINFOTABLE *fileInfoT
 	param.overall = height - 1;
 	param.message = NULL;
 	for (int y = 0; y < height; y++) {
-		LPBYTE dest = iface->lpVtbl->GetLineBits(bitmap, y);
-		for (int x = 0; x < width; x++) {
-			int rgb = *pixels++;
-			/* 0xRRGGBB -> 0xBB 0xGG 0xRR */
-			*dest++ = (BYTE) rgb;
-			*dest++ = (BYTE) (rgb >> 8);
-			*dest++ = (BYTE) (rgb >> 16);
-		}
+		RECOIL_ConvertPixels(iface->lpVtbl->GetLineBits(bitmap, y), pixels + y * width, width, RECOIL_PIXEL_FORMAT_BGR24);
 		if ((flags & IMAGINELOADPARAM_CALLBACK) != 0) {
 			param.current = y;
 			if (!loadParam->callback.proc(&param)) {
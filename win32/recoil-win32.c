@@ -53,8 +53,14 @@ int RECOILWin32_SlurpFileW(LPCWSTR filename, uint8_t *buffer, int len)
 
 typedef struct {
 	int (*readFile)(const RECOIL *self, const char *filename, uint8_t *content, int contentLength);
+	bool (*isCancelled)(const RECOIL *self);
 } RECOILVtbl;
 
+static bool RECOILWin32_IsCancelled(const RECOIL *self)
+{
+	return false;
+}
+
 static int RECOILWin32_ReadFileA(const RECOIL *self, const char *filename, uint8_t *content, int contentLength)
 {
 	return RECOILWin32_SlurpFileA(filename, content, contentLength);
@@ -70,7 +76,7 @@ static int RECOILWin32_ReadFileW(const RECOIL *self, const char *filename, uint8
 
 bool RECOILWin32_DecodeA(RECOIL *self, const char *filename, uint8_t const *content, int contentLength)
 {
-	static const RECOILVtbl vtbl = { RECOILWin32_ReadFileA };
+	static const RECOILVtbl vtbl = { RECOILWin32_ReadFileA, RECOILWin32_IsCancelled };
 	*(const RECOILVtbl **) self = &vtbl;
 	return RECOIL_Decode(self, filename, content, contentLength);
 }
@@ -80,7 +86,7 @@ bool RECOILWin32_DecodeW(RECOIL *self, LPCWSTR filename, uint8_t const *content,
 	char utf8Filename[4096];
 	if (WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS, filename, -1, utf8Filename, sizeof(utf8Filename), NULL, NULL) <= 0)
 		return false;
-	static const RECOILVtbl vtbl = { RECOILWin32_ReadFileW };
+	static const RECOILVtbl vtbl = { RECOILWin32_ReadFileW, RECOILWin32_IsCancelled };
 	*(const RECOILVtbl **) self = &vtbl;
 	return RECOIL_Decode(self, utf8Filename, content, contentLength);
 }
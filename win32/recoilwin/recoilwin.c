@@ -312,40 +312,8 @@ static void ZoomSet(int value)
 	Repaint(true);
 }
 
-static bool OpenImage(bool show_error)
+static void ShowImage(void)
 {
-	SetMenuEnabled(IDM_PREVFILE, true);
-	SetMenuEnabled(IDM_NEXTFILE, true);
-	SetMenuEnabled(IDM_FIRSTFILE, true);
-	SetMenuEnabled(IDM_LASTFILE, true);
-
-	static BYTE content[RECOIL_MAX_CONTENT_LENGTH];
-	int content_len = RECOILWin32_SlurpFile(image_filename, content, sizeof(content));
-	if (content_len < 0) {
-		if (show_error)
-			ShowError("Cannot open file");
-		return false;
-	}
-
-	image_loaded = RECOILWin32_Decode(recoil, image_filename, content, content_len);
-	SetMenuEnabled(IDM_SAVEAS, image_loaded);
-	SetMenuEnabled(IDM_COPY, image_loaded);
-	SetMenuEnabled(IDM_FULLSCREEN, image_loaded);
-	SetMenuEnabled(IDM_ZOOMIN, image_loaded);
-	SetMenuEnabled(IDM_ZOOMOUT, image_loaded);
-	for (int id = IDM_ZOOM1; id <= IDM_ZOOM9; id++)
-		SetMenuEnabled(id, image_loaded);
-	if (!image_loaded) {
-		SetMenuEnabled(IDM_INVERT, false);
-		SetWindowText(hWnd, _T(APP_TITLE));
-		SetWindowText(hStatus, NULL);
-		if (show_error) {
-			Repaint(true);
-			ShowError("Decoding error");
-		}
-		return false;
-	}
-
 	int width = RECOIL_GetWidth(recoil);
 	int height = RECOIL_GetHeight(recoil);
 	const int *palette = RECOIL_ToPalette(recoil);
@@ -400,6 +368,43 @@ static bool OpenImage(bool show_error)
 		memcpy(bitmap_pixels + (height - 1 - y) * bytes_per_line, pixels + y * pixels_stride, pixels_stride);
 
 	Repaint(true);
+}
+
+static bool OpenImage(bool show_error)
+{
+	SetMenuEnabled(IDM_PREVFILE, true);
+	SetMenuEnabled(IDM_NEXTFILE, true);
+	SetMenuEnabled(IDM_FIRSTFILE, true);
+	SetMenuEnabled(IDM_LASTFILE, true);
+
+	static BYTE content[RECOIL_MAX_CONTENT_LENGTH];
+	int content_len = RECOILWin32_SlurpFile(image_filename, content, sizeof(content));
+	if (content_len < 0) {
+		if (show_error)
+			ShowError("Cannot open file");
+		return false;
+	}
+
+	image_loaded = RECOILWin32_Decode(recoil, image_filename, content, content_len);
+	SetMenuEnabled(IDM_SAVEAS, image_loaded);
+	SetMenuEnabled(IDM_COPY, image_loaded);
+	SetMenuEnabled(IDM_FULLSCREEN, image_loaded);
+	SetMenuEnabled(IDM_ZOOMIN, image_loaded);
+	SetMenuEnabled(IDM_ZOOMOUT, image_loaded);
+	for (int id = IDM_ZOOM1; id <= IDM_ZOOM9; id++)
+		SetMenuEnabled(id, image_loaded);
+	if (!image_loaded) {
+		SetMenuEnabled(IDM_INVERT, false);
+		SetWindowText(hWnd, _T(APP_TITLE));
+		SetWindowText(hStatus, NULL);
+		if (show_error) {
+			Repaint(true);
+			ShowError("Decoding error");
+		}
+		return false;
+	}
+
+	ShowImage();
 	return true;
 }
 
@@ -521,12 +526,21 @@ static void SelectAndSaveImage(void)
 		ShowCursor(FALSE);
 }
 
+static void ApplyPalette(void)
+{
+	// Atari 8-bit and C64 pictures can be re-rendered without decoding again
+	if (RECOIL_Repalette(recoil))
+		ShowImage();
+	else
+		OpenImage(true);
+}
+
 static void SetNtsc(bool ntsc)
 {
 	RECOIL_SetNtsc(recoil, ntsc);
 	CheckMenuRadioItem(hMenu, IDM_PAL, IDM_NTSC, ntsc ? IDM_NTSC : IDM_PAL, MF_BYCOMMAND);
 	if (image_loaded)
-		OpenImage(true);
+		ApplyPalette();
 }
 
 static bool OpenPalette(LPCTSTR filename)
@@ -587,7 +601,7 @@ static void SelectAndOpenPalette(void)
 	if (GetOpenFileName(&ofn) && OpenPalette(palette_filename)) {
 		SetMenuEnabled(IDM_RESETPALETTES, true);
 		if (image_loaded)
-			OpenImage(true);
+			ApplyPalette();
 	}
 	if (fullscreen)
 		ShowCursor(FALSE);
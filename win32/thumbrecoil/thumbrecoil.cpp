@@ -36,6 +36,7 @@
 #endif
 
 #include "recoil-win32.h"
+#include "recoil-pixels.h"
 #include "formats.h"
 
 static const char extensions[][6] = { THUMBRECOIL_EXTS };
@@ -90,9 +91,7 @@ class CRECOILThumbProvider : IPersistFile, IExtractImage
 		HBITMAP hbmp = CreateDIBSection(nullptr, &bmi, DIB_RGB_COLORS, reinterpret_cast<void **>(&pBits), nullptr, 0);
 		if (hbmp == nullptr)
 			return E_OUTOFMEMORY;
-		int pixels_count = width * height;
-		for (int i = 0; i < pixels_count; i++)
-			pBits[i] = pixels[i] | 0xff000000;
+		RECOIL_ConvertPixels(pBits, pixels, width * height, RECOIL_PIXEL_FORMAT_BGRA32);
 		*phBitmap = hbmp;
 		return S_OK;
 	}